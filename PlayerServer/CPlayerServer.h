@@ -10,7 +10,13 @@
 #include "HttpParser.h"
 #include "MysqlClient.h"
 #include "Crypto.h"
+#include "Connection.h"
+#include "Uring.h"
+#include <sys/eventfd.h>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 
 DECLARE_TABLE_CLASS(user_mysql, _mysql_table_)
 DECLARE_MYSQL_FIELD(TYPE_INT, user_id, NOT_NULL | PRIMARY_KEY | AUTOINCREMENT, "INTEGER", "", "", "")
@@ -48,12 +54,72 @@ DECLARE_TABLE_CLASS_EDN()
 
 #define WARN_CONTINUE(ret) if(ret!=0){TRACEW("ret= %d errno = %d msg = [%s]", ret, errno, strerror(errno));continue;}
 
+//߳ epoll ĶӦʽ
+enum ReactorMode {
+    REACTOR_SHARED = 0,     //й̹߳һ epollEPOLLONESHOT ιһ
+    REACTOR_ROUNDROBIN = 1, //ÿ̶߳ռһ epoll
+    REACTOR_LEASTLOAD = 2   //ÿ̶߳ռһ epollӷָٵ
+};
+
+//¼ˣʱѡ
+enum EventBackend {
+    BACKEND_EPOLL = 0, //֪ͨepoll_wait ֮Լ read/write
+    BACKEND_URING = 1  //֪ͨio_uring ෢ accept/recv sendÿֻһں
+};
+
+//io_uring user_data ĸ 8 λ¼ӦĲ
+enum UringOp {
+    URING_OP_RECV = 1,
+    URING_OP_SEND = 2,
+    URING_OP_ACCEPT = 3,
+    URING_OP_WAKE = 4,  //eventfd߳Ͷ
+    URING_OP_TIMER = 5, //timerfdʱһ
+    URING_OP_CANCEL = 6 //ȡ෢ accept׼ͣգ
+};
+#define URING_OP_SHIFT 56
+
+#define HTTP_REQUEST_MAX (64 * 1024) //󣨺δˮ󣩵ֽ
+#define HTTP_HEADER_TIMEOUT 10000     //ӽյֽ𣬴ޣ룩
+#define HTTP_KEEPALIVE_TIMEOUT 60000  //Ӧдȴһʱ䣨룩
+#define HTTP_IDLE_TIMEOUT 30000       //ӦѹʱԶһֱʱ䣨룩
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69 //Linux 5.11ͷļû
+#endif
+
+//ӶʱͣǼʱֽڵϣſʱݴҳе keep-alive 
+enum TimerKind {
+    TIMER_HEADER = 1,    //ֹʱ
+    TIMER_KEEPALIVE = 2, //ȴһ
+    TIMER_IDLE = 3       //Ӧѹ
+};
+
+//һ¼ѭӱǼڽ̼ CConnectionSlab 
+//ռģʽͬһѭдֻ߳̽
+struct CReactor {
+    ~CReactor() { if (wake != -1) close(wake); }
+
+    CEpoll epoll;
+    CTimingWheel wheel;          //ѭӵĳʱ
+    std::atomic<int> load{ 0 };  //ǰٸطϱ
+    //½ io_uring ģʽʹãring ߳ǰã̶֮߳ռֻܾ߳ incoming + wake Ͷ
+    CUring ring;
+    int wake = -1;                       //eventfd
+    std::mutex mutex;                    // incoming
+    std::vector<CSocketBase*> incoming;  //ȴѭӹܵ
+    bool accepting = false;              //෢ accept ںУ̷߳ʣ
+    std::vector<uint64_t> stalled;       //SQ Ų send Ӽһոԣ̷߳ʣ
+};
+
 
 class CPlayerServer : public CBusiness
 {
 public:
-    explicit CPlayerServer(unsigned count)
-        : CBusiness(), m_count(count){}
+    explicit CPlayerServer(unsigned count, ReactorMode mode = REACTOR_SHARED, EventBackend backend = BACKEND_EPOLL)
+        : CBusiness(), m_count(count), m_mode(mode), m_backend(backend){
+        //ring ֻһ߳ύio_uring ÿ߳һѭ
+        if ((m_backend == BACKEND_URING) && (m_mode == REACTOR_SHARED)) m_mode = REACTOR_ROUNDROBIN;
+    }
 
     ~CPlayerServer(){
         if (m_db) {
@@ -62,19 +128,74 @@ public:
             db->Close();
             delete db;
         }
-        m_epoll.Close();
+        m_stop = true;
+        for (CReactor* reactor : m_reactors) {
+            reactor->epoll.Close();
+            if (reactor->wake != -1) {
+                uint64_t one = 1;
+                write(reactor->wake, &one, sizeof(one));
+            }
+        }
         m_pool.Close();
-        for (auto& it : m_mapClients) {
-            if (it.second) {
-                delete it.second;
+        if (m_server) {
+            delete m_server;
+            m_server = nullptr;
+        }
+        //ȹ ringںȡ;ͷӼ䷢ͻ
+        for (CReactor* reactor : m_reactors) {
+            for (CSocketBase* pClient : reactor->incoming) delete pClient;
+            delete reactor;
+        }
+        m_reactors.clear();
+        m_slab.ForEach([this](CConnection* conn) { m_slab.Release(conn); });
+    }
+
+    //¼ѭio_uring  ring Ҳｨã֮߳ǰʧʱûѭӹܵ reactor
+    //0 ɹ-12 ʱ֣-14 eventfd-16 ring-5/-13 epoll
+    int CreateReactors(size_t loops) {
+        for (size_t i = 0; i < loops; i++) {
+            CReactor* reactor = new CReactor();
+            m_reactors.push_back(reactor);
+            int ret = reactor->wheel.Init();
+            ERR_RETURN(ret, -12);
+            if (m_backend == BACKEND_URING) {
+                reactor->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                ret = (reactor->wake == -1) ? -1 : 0;
+                ERR_RETURN(ret, -14);
+                ret = reactor->ring.Init();
+                if (ret == 0) ret = reactor->ring.SetupBuffers();
+                ERR_RETURN(ret, -16);
+                continue;
             }
+            ret = reactor->epoll.Create(m_count);
+            ERR_RETURN(ret, -5);
+            ret = reactor->epoll.Add(reactor->wheel, EpollData((uint64_t)CONNECTION_TIMER), EPOLLIN);
+            ERR_RETURN(ret, -13);
         }
-        m_mapClients.clear();
+        return 0;
+    }
+
+    //ӳʱ룬0 ʾޣ BusinessProcess ֮ǰ
+    void SetTimeouts(unsigned header, unsigned keepalive, unsigned idle) {
+        m_headerTimeout = header;
+        m_keepaliveTimeout = keepalive;
+        m_idleTimeout = idle;
+    }
+
+    //æѯ epoll ˣ¼ѭ 0 ʱ epoll_waitת spin ΢¼0 ʾر
+    //busypoll>0 ʱ SO_BUSY_POLL΢룩prefer ټ SO_PREFER_BUSY_POLL net.core.busy_read Ҫ CAP_NET_ADMIN
+    // BusinessProcess ֮ǰãת봦ʱۼƵ spinning/working
+    void SetBusyPoll(unsigned spin, unsigned busypoll = 0, bool prefer = false) {
+        m_spin = spin;
+        m_busypoll = busypoll;
+        m_preferBusyPoll = prefer;
     }
 
+    virtual unsigned Threads() const { return (m_count == 0) ? 1 : m_count; }
+
     virtual int BusinessProcess(CProcess* proc) {
-        using namespace std::placeholders;
         int ret = 0; 
+        m_proc = proc;
         m_db = new CMysqlClient();
         if(m_db==NULL){
             TRACEE("no more memory!");
@@ -88,52 +209,127 @@ public:
         args["db"] = "edoyun";
         ret = m_db->Connect(args);
         ERR_RETURN(ret, -2);
-        ret = setConnectedCallback(&CPlayerServer::Connected, this, _1);
+        ret = setConnectedCallback(&CPlayerServer::Connected, this);
         ERR_RETURN(ret, -3);
-        ret = setRecvCallback(&CPlayerServer::Received, this, _1, _2);
+        ret = setRecvCallback(&CPlayerServer::Received, this);
         ERR_RETURN(ret, -4);
-        ret = m_epoll.Create(m_count);
-        ERR_RETURN(ret, -5);
-        ret = m_pool.Start(m_count);
+        m_busy = MakeBusyResponse();
+        if (m_tls && (m_backend == BACKEND_URING)) {//io_uring ֱշģTLS ֻ֧ epoll 
+            TRACEE("tls requires the epoll backend");
+            return -15;
+        }
+        ret = m_slab.Init();
+        ERR_RETURN(ret, -11);
+        if (m_count == 0) m_count = 1;
+        //ģʽֻһѭ̶߳ȴռģʽÿ߳һѭ
+        size_t loops = (m_mode == REACTOR_SHARED) ? 1 : m_count;
+        ret = CreateReactors(loops);
+        if ((ret == -16) && (m_backend == BACKEND_URING)) {//ں˲֧ io_uring 򻺳廷˻ epoll
+            TRACEW("io_uring unavailable, falling back to epoll");
+            for (CReactor* reactor : m_reactors) delete reactor;
+            m_reactors.clear();
+            m_backend = BACKEND_EPOLL;
+            ret = CreateReactors(loops);
+        }
+        if (ret != 0) return ret;
+        ret = m_pool.Start(m_count, m_poolparam);
         ERR_RETURN(ret, -6);
+        if (m_listen.attr & SOCK_ISSERVER) {//SO_REUSEPORT ģʽмֱ߳ accept
+            m_server = new CSocket();
+            if (m_server == NULL) {
+                TRACEE("no more memory!");
+                return -8;
+            }
+            ret = m_server->Init(m_listen);
+            ERR_RETURN(ret, -9);
+            //io_uring ģʽɸѭԼύ෢ accept
+            for (CReactor* reactor : m_reactors) {
+                if (m_backend == BACKEND_URING) break;
+                ret = reactor->epoll.Add(*m_server, EpollData((uint64_t)CONNECTION_LISTENER), ListenerEvents());
+                ERR_RETURN(ret, -10);
+            }
+        }
         for (unsigned i = 0; i < m_count; i++) {
-            ret = m_pool.AddTask(&CPlayerServer::ThreadFunc, this);
+            CReactor* reactor = m_reactors[i % m_reactors.size()];
+            if (m_backend == BACKEND_URING) {
+                ret = m_pool.AddTask(&CPlayerServer::UringThreadFunc, this, reactor);
+            }
+            else {
+                ret = m_pool.AddTask(&CPlayerServer::ThreadFunc, this, reactor);
+            }
             ERR_RETURN(ret, -7);
         }
-        int sock = 0;
-        sockaddr_in addrin;
-        while (m_epoll != -1) {
-            ret = proc->RecvSocket(sock, &addrin);
-            if (ret < 0 || (sock == 0))break;
-            CSocketBase* pClient = new CSocket(sock);
-            if (pClient == NULL) {
-                close(sock);
-                continue;
+        int socks[SOCKET_BATCH_MAX];
+        sockaddr_in addrins[SOCKET_BATCH_MAX];
+        size_t count = 0;
+        while (!m_stop) {//SO_REUSEPORT ģʽ´˴ֻȴ˳
+            ret = proc->RecvSockets(socks, addrins, count);
+            if (ret == 1) {//Ҫ˳ſպ󷵻
+                Drain(proc->DrainTimeout());
+                break;
             }
-            ret = pClient->Init(CSockParam(&addrin, SOCK_ISIP));
-            if (ret != 0) {
-                TRACEW("Init failed ret=%d...", ret);
-                delete pClient; 
+            if (ret == -4) {
+                TRACEW("RecvSockets dropped a malformed batch");
                 continue;
             }
-            m_mapClients[sock] = pClient;
-            ret = m_epoll.Add(sock, EpollData((void*)pClient), EPOLLIN | EPOLLONESHOT);
-            if (ret != 0) {
-                TRACEW("Epoll Add failed ret=%d...", ret);
-                CloseClient(pClient);
-                continue;
-            }
-            if (m_connectedcallback) {
-                (*m_connectedcallback)(pClient);
+            if (ret < 0) break;
+            for (size_t i = 0; i < count; i++) {//Ǽǵ epoll
+                CSocketBase* pClient = NewSocket(socks[i], addrins[i].sin_family == AF_UNIX);
+                if (pClient == NULL) {
+                    close(socks[i]);
+                    continue;
+                }
+                //̰ѱ׽ӵĵַ AF_UNIXû IP ַɼ
+                ret = pClient->Init((addrins[i].sin_family == AF_UNIX) ? CSockParam() : CSockParam(&addrins[i], SOCK_ISIP));
+                if (ret != 0) {
+                    TRACEW("Init failed ret=%d...", ret);
+                    delete pClient;
+                    continue;
+                }
+                if (m_backend == BACKEND_URING) {
+                    HandOff(PickReactor(), pClient);
+                }
+                else {
+                    AddClient(PickReactor(), pClient);
+                }
             }
-            
+            ReportLoad();
         }
+        m_stop = true;
         return 0;
     }
 
+    //˳ֹͣӣصе keep-alive ӣ;򳬹 timeout 
+    //ֵ0 ȫѹرգ-1 ʱ
+    int Drain(unsigned timeout) {
+        {//׼ƻ⣬׽ shutdown ֱ֮һ epoll
+            std::lock_guard<std::mutex> lock(m_admissionMutex);
+            m_draining = true;
+            if (m_server) {//SO_REUSEPORT ģʽȴ epoll ժ shutdown ʹ˳˿飬ӽ
+                for (CReactor* reactor : m_reactors) {
+                    if (m_backend != BACKEND_URING) reactor->epoll.Del(*m_server);
+                }
+                shutdown(*m_server, SHUT_RDWR);
+            }
+        }
+        for (CReactor* reactor : m_reactors) {
+            reactor->wheel.ForEach(&CPlayerServer::OnDrain);
+        }
+        std::unique_lock<std::mutex> lock(m_drainMutex);
+        bool done = m_drainCond.wait_for(lock, std::chrono::milliseconds(timeout),
+            [this]() { return m_clients.load(std::memory_order_relaxed) <= 0; });
+        TRACEI("drain %s, %d clients left", done ? "finished" : "timed out", m_clients.load(std::memory_order_relaxed));
+        return done ? 0 : -1;
+    }
+
 private:
     int Connected(CSocketBase* pClient) {
         //TODO:ͻӴ 򵥴ӡһ¿ͻϢ
+        if (pClient->IsLocal()) {//ͬ׽룺¼Զ˽
+            ucred cred;
+            if (pClient->PeerCred(cred) == 0) TRACEI("client connected pid %d uid %d gid %d", (int)cred.pid, (int)cred.uid, (int)cred.gid);
+            return 0;
+        }
         sockaddr_in* paddr = *pClient;
         TRACEI("client connected addr %s port:%d", inet_ntoa(paddr->sin_addr), paddr->sin_port);
         return 0;
@@ -152,8 +348,12 @@ private:
         }
         response = MakeResponse(ret);
         ret = pClient->Send(response);
-        if (ret != 0) {
+        if (ret < 0) {
             TRACEE("http response failed!%d [%s]", ret, (char*)response);
+            return ret; // дʧܻͶгˮλɵ÷Ͽ
+        }
+        else if (ret > 0) {
+            TRACEI("http response queued, pending=%d", (int)pClient->Pending());
         }
         else {
             TRACEI("http response success!%d", ret);
@@ -190,7 +390,11 @@ private:
                 Buffer sql = dbuser.Query("user_name=\"" + user + "\"");
                 Buffer pwd;
                 {
+                    m_dbQueue.fetch_add(1, std::memory_order_relaxed);//Ŷӵȴݿ
+                    ReportLoad();
                     std::lock_guard<std::mutex> lock(m_dbMutex);
+                    m_dbQueue.fetch_sub(1, std::memory_order_relaxed);
+                    ReportLoad();
                     int ret = m_db->Exec(sql, result, dbuser);
                     if (ret != 0) {
                         TRACEE("sql=%s ret=%d", (char*)sql, ret);
@@ -265,65 +469,693 @@ private:
         TRACEI("response: %s", (char*)result);
         return result;
     }
-    void CloseClient(CSocketBase* pClient) {
-
-        if (!pClient) return;
-        int fd = (int)(*pClient);
-        m_epoll.Del(*pClient); // ȴ epoll Ƴ
-        auto it = m_mapClients.find(fd);
-
-        if (it != m_mapClients.end()) {
-
-            m_mapClients.erase(it);
+    //ʱ 503 ӦʱһΣֱ֮ӷͣҵ JSON л
+    Buffer MakeBusyResponse() {
+        Json::Value root;
+        root["status"] = 503;
+        root["message"] = "Server busy, please retry later";
+        Buffer json = root.toStyledString();
+        char temp[64] = "";
+        Buffer result = "HTTP/1.1 503 Service Unavailable\r\n";
+        snprintf(temp, sizeof(temp), "Retry-After: %u\r\n", m_limit.retryafter);
+        result += temp;
+        result += "Server: Edoyun/1.0\r\nContent-Type: application/json; charset=utf-8\r\nConnection: close\r\n";
+        snprintf(temp, sizeof(temp), "Content-Length: %d\r\n\r\n", (int)json.size());
+        result += temp;
+        result += json;
+        return result;
+    }
+    //׽ epoll еĹע¼
+    //ģʽñشAcceptClients  accept4  EAGAINͬһ epoll ϵ̲߳ᱻظ
+    //ռģʽÿѭϼ׽֣EPOLLEXCLUSIVE һֻһѭ
+    uint32_t ListenerEvents() const {
+        return (m_mode == REACTOR_SHARED) ? (EPOLLIN | EPOLLET) : (EPOLLIN | EPOLLEXCLUSIVE);
+    }
+    //ޣһﵽʱ󲻽ҵֱӻ 503
+    bool Overloaded() const {
+        if (m_limit.connsoft && (m_clients.load(std::memory_order_relaxed) >= (int)m_limit.connsoft)) return true;
+        if (m_limit.requestsoft && (m_inflight.load(std::memory_order_relaxed) >= (int)m_limit.requestsoft)) return true;
+        if (m_limit.dbsoft && (m_dbQueue.load(std::memory_order_relaxed) >= (int)m_limit.dbsoft)) return true;
+        return false;
+    }
+    //Ӳޣһﵽʱ̱ͣͣ
+    bool Saturated() const {
+        if (m_limit.connhard && (m_clients.load(std::memory_order_relaxed) >= (int)m_limit.connhard)) return true;
+        if (m_limit.requesthard && (m_inflight.load(std::memory_order_relaxed) >= (int)m_limit.requesthard)) return true;
+        if (m_limit.dbhard && (m_dbQueue.load(std::memory_order_relaxed) >= (int)m_limit.dbhard)) return true;
+        return false;
+    }
+    //жǷ񱥺ͣ״̬仯ʱ true÷ϱ
+    //SO_REUSEPORT ģʽͬʱͣ/̵ָ acceptepoll ģʽժ/һؼ׽֣io_uring ģʽѸѭд
+    bool UpdateAdmission() {
+        if (!m_limit.connhard && !m_limit.requesthard && !m_limit.dbhard) return false;
+        if (Saturated() == m_saturated.load(std::memory_order_relaxed)) return false;
+        std::lock_guard<std::mutex> lock(m_admissionMutex);
+        bool saturated = Saturated();
+        if (saturated == m_saturated.load(std::memory_order_relaxed)) return false;
+        m_saturated = saturated;
+        //д棺 ReportLoad Ѿɵı״̬дȥ
+        if (m_stats) m_stats->saturated.store(saturated ? 1 : 0, std::memory_order_relaxed);
+        if (saturated) TRACEW("worker saturated: clients=%d inflight=%d db=%d", m_clients.load(), m_inflight.load(), m_dbQueue.load());
+        else TRACEI("worker recovered");
+        if (m_server && !m_draining) {
+            for (CReactor* reactor : m_reactors) {
+                if (m_backend == BACKEND_URING) {
+                    uint64_t one = 1;
+                    write(reactor->wake, &one, sizeof(one));
+                }
+                else if (saturated) {
+                    reactor->epoll.Del(*m_server);
+                }
+                else {
+                    reactor->epoll.Add(*m_server, EpollData((uint64_t)CONNECTION_LISTENER), ListenerEvents());
+                }
+            }
+        }
+        return true;
+    }
+    //Ϊѡ¼ѭ
+    CReactor* PickReactor() {
+        if (m_reactors.size() == 1) return m_reactors[0];
+        if (m_mode == REACTOR_LEASTLOAD) {
+            CReactor* best = m_reactors[0];
+            for (CReactor* reactor : m_reactors) {
+                if (reactor->load.load(std::memory_order_relaxed) < best->load.load(std::memory_order_relaxed)) {
+                    best = reactor;
+                }
+            }
+            return best;
+        }
+        return m_reactors[m_next++ % m_reactors.size()];
+    }
+    //ǼӲѡѭ epoll󴥷ӻص
+    int AddClient(CReactor* reactor, CSocketBase* pClient) {
+        int sock = (int)(*pClient);
+        BusyPollSocket(pClient);
+        CConnection* conn = m_slab.Acquire(pClient);
+        if (conn == nullptr) {
+            TRACEW("no free connection slot for fd %d (capacity %llu)", sock, (unsigned long long)m_slab.Capacity());
+            delete pClient;
+            return -2;
+        }
+        reactor->load.fetch_add(1, std::memory_order_relaxed);
+        m_clients.fetch_add(1, std::memory_order_relaxed);
+        // epoll ֮ǰ׸Ľֹʱ䣬֮ʱֻѭ
+        conn->deadline = true;
+        reactor->wheel.Schedule(&conn->timer, m_headerTimeout, TIMER_HEADER);
+        //شÿζ EAGAINռģʽҪÿһ
+        uint32_t events = (m_mode == REACTOR_SHARED) ? (EPOLLIN | EPOLLET | EPOLLONESHOT) : (EPOLLIN | EPOLLET);
+        int ret = reactor->epoll.Add(sock, EpollData(conn->Key()), events);
+        if (ret != 0) {
+            TRACEW("Epoll Add failed ret=%d...", ret);
+            CloseClient(reactor, conn);
+            return -1;
+        }
+        if (m_connectedcallback) {
+            m_connectedcallback(pClient);
+        }
+        return 0;
+    }
+    //ƽ fd ˺Ƿ TLS ѡͣ׽ͬ TLS
+    CSocketBase* NewSocket(int sock, bool local) {
+        if (m_backend == BACKEND_URING) return new CUringSocket(sock);
+        if (m_tls && !local) return new CTlsSocket(sock, m_tls);
+        return new CSocket(sock);
+    }
+    //SO_REUSEPORT ģʽ Link õ CSocket fd  TLS ӣʧʱرӷ nullptr
+    CSocketBase* WrapTls(CSocketBase* pClient) {
+        sockaddr_in addr = *(sockaddr_in*)(*pClient);
+        int sock = pClient->Detach();
+        delete pClient;
+        CSocketBase* tls = new CTlsSocket(sock, m_tls);
+        int ret = tls->Init(CSockParam(&addr, SOCK_ISIP));
+        if (ret != 0) {
+            TRACEW("tls init failed ret=%d", ret);
+            delete tls;
+            return nullptr;
+        }
+        return tls;
+    }
+    //SO_REUSEPORT ģʽ׽ֿɶʱȡӣռģʽڵǰѭ
+    void AcceptClients(CReactor* reactor) {
+        while ((m_server != nullptr) && !Saturated()) {//ﵽӲ޺ʣں˶У ReportLoad ժ¼׽
+            CSocketBase* pClient = nullptr;
+            int ret = m_server->Link(&pClient);
+            if (ret != 0 || pClient == nullptr) break;//EAGAINѱ߳ȡ߻ѿ
+            if (m_tls) pClient = WrapTls(pClient);
+            if (pClient == nullptr) continue;
+            AddClient(reactor, pClient);
+        }
+        ReportLoad();
+    }
+    void CloseClient(CReactor* reactor, CConnection* conn) {
 
+        if (!conn) return;
+        reactor->epoll.Del(conn->Fd()); // ȴ epoll Ƴ
+        reactor->wheel.Cancel(&conn->timer);
+        reactor->load.fetch_sub(1, std::memory_order_relaxed);
+        m_clients.fetch_sub(1, std::memory_order_relaxed);
+        m_slab.Release(conn); // 黹λر fd
+        ReportLoad();
+    }
+    //Ѹд빲棬ʱֱӶȡ״̬仯ʱپͨѸ̣ͣ accept ܼʱָ
+    //ûп棨 CServer ʱÿζͨϱſڼӹʱ Drain
+    void ReportLoad() {
+        bool changed = UpdateAdmission();
+        int clients = m_clients.load(std::memory_order_relaxed);
+        if (m_stats) {
+            m_stats->connections.store(clients, std::memory_order_relaxed);
+            m_stats->inflight.store(m_inflight.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            m_stats->queue.store(m_dbQueue.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        if (changed || (m_stats == nullptr)) m_proc->SendLoad(clients);
+        if ((clients <= 0) && m_draining) {
+            { std::lock_guard<std::mutex> lock(m_drainMutex); }
+            m_drainCond.notify_all();
+        }
+    }
+    //ʱÿ̶ˢһֻ¼ѭסʱŻֹͣ
+    void Heartbeat() {
+        if (m_stats) m_stats->heartbeat.store(CControlPlane::Now(), std::memory_order_relaxed);
+    }
+    //ӵ SO_BUSY_POLLʱںѯУǵжϣʧֻʾһΣճʹ
+    void BusyPollSocket(CSocketBase* pClient) {
+        if ((m_busypoll == 0) || pClient->IsLocal()) return;
+        int value = (int)m_busypoll;
+        int ret = setsockopt(*pClient, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value));
+        if ((ret == 0) && m_preferBusyPoll) {
+            value = 1;
+            ret = setsockopt(*pClient, SOL_SOCKET, SO_PREFER_BUSY_POLL, &value, sizeof(value));
+        }
+        if ((ret != 0) && !m_busyPollFailed.exchange(true)) {
+            TRACEW("set busy poll failed errno=%d msg=%s", errno, strerror(errno));
         }
-        delete pClient; // ͷڴ
+    }
+    //æѯ 0 ʱ epoll_waitת m_spin ΢¼spin ۼӿת
+    ssize_t WaitBusy(CReactor* reactor, EPEvents& events, uint64_t& spin) {
+        if (m_spin == 0) return reactor->epoll.WaitEvents(events);
+        auto start = std::chrono::steady_clock::now();
+        auto limit = start + std::chrono::microseconds(m_spin);
+        auto now = start;
+        ssize_t size = 0;
+        while ((size = reactor->epoll.WaitEvents(events, 0)) == 0) {
+            now = std::chrono::steady_clock::now();
+            if (now >= limit) break;
+        }
+        if (size != 0) now = std::chrono::steady_clock::now();
+        spin += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+        if (size != 0) return size;
+        return reactor->epoll.WaitEvents(events);
+    }
+    //ѱ߳ۼƵĿת/ʱܵ棨΢룩һ΢Ĳ´
+    void ReportBusy(uint64_t& spin, uint64_t& work) {
+        if (m_stats) {
+            m_stats->spinning.fetch_add(spin / 1000, std::memory_order_relaxed);
+            m_stats->working.fetch_add(work / 1000, std::memory_order_relaxed);
+        }
+        m_spinning.fetch_add(spin / 1000, std::memory_order_relaxed);
+        m_working.fetch_add(work / 1000, std::memory_order_relaxed);
+        spin %= 1000;
+        work %= 1000;
     }
 private:
-    int ThreadFunc()
+    int ThreadFunc(CReactor* reactor)
     {
         EPEvents events;
-        while (m_epoll != -1) {
-            ssize_t size = m_epoll.WaitEvents(events);
+        uint64_t spin = 0, work = 0;//æѯͳƣ룩ÿʱ̶ֿȻһ
+        auto reported = std::chrono::steady_clock::now();
+        while (reactor->epoll != -1) {
+            ssize_t size = WaitBusy(reactor, events, spin);
             if (size < 0) break;
+            auto begin = (m_spin > 0) ? std::chrono::steady_clock::now() : reported;
 
             for (ssize_t i = 0; i < size; i++) {
-                CSocketBase* pClient = (CSocketBase*)events[i].data.ptr;
-                if (!pClient) continue;
+                if (events[i].data.u64 == CONNECTION_TIMER) {
+                    //ʱֻرնд EPOLLHUP Ĺر̣
+                    //ڴӵ̣߳ģʽ
+                    reactor->wheel.Expire(&CPlayerServer::OnTimeout);
+                    Heartbeat();
+                    continue;
+                }
+                if (events[i].data.u64 == CONNECTION_LISTENER) {
+                    if (events[i].events & EPOLLIN) AcceptClients(reactor);
+                    continue;
+                }
 
+                CConnection* conn = m_slab.Find(events[i].data.u64);
+                if (!conn) continue;//¼ѹرջ fd ѱӸ
                 if (events[i].events & EPOLLERR) {
-                    TRACEE("EPOLLERR detected on %p", pClient);
-                    CloseClient(pClient);
+                    TRACEE("EPOLLERR detected on %p", conn);
+                    CloseClient(reactor, conn);
                     continue;
                 }
 
-                if (events[i].events & EPOLLIN) {
-                    Buffer data(4096);
-                    int ret = pClient->Recv(data);
-
-                    if (ret > 0) {
-                        if (m_recvcallback) {
-                            (*m_recvcallback)(pClient, data);
-                        }
-                        m_epoll.Modify((int)(*pClient), EPOLLIN | EPOLLONESHOT, EpollData((void*)pClient));
-                    }else if (ret == -3) {
-                        TRACEI("Client disconnected ptr=%p", pClient);
-                        CloseClient(pClient);
-                    }else {
+                if (events[i].events & EPOLLOUT) {//ں˷ͻпλдѹ
+                    int ret = conn->sock->Flush();
+                    if (ret < 0) {
+                        TRACEE("Flush Failed. ret=%d errno=%d msg=%s", ret, errno, strerror(errno));
+                        CloseClient(reactor, conn);
+                        continue;
+                    }
+                    //ѹдȴѹڼڶټ
+                    if ((ret == 0) && (Dispatch(conn) < 0)) {
+                        CloseClient(reactor, conn);
+                        continue;
+                    }
+                    if (conn->sock->Pending() > 0) {
+                        Rearm(reactor, conn, events[i].events);
+                        continue;
+                    }
+                }
+
+                if (events[i].events & (EPOLLIN | EPOLLOUT | EPOLLHUP)) {
+                    int ret = ReadClient(conn);
+                    if (ret == -3) {
+                        TRACEI("Client disconnected ptr=%p", conn);
+                        CloseClient(reactor, conn);
+                    }else if (ret < 0) {
                         TRACEE("Recv Failed. ret=%d errno=%d msg=%s", ret, errno, strerror(errno));
-                        CloseClient(pClient);
+                        CloseClient(reactor, conn);
+                    }else {
+                        Rearm(reactor, conn, events[i].events);
                     }
                 }
             }
+            if (m_spin == 0) continue;
+            auto now = std::chrono::steady_clock::now();
+            work += std::chrono::duration_cast<std::chrono::nanoseconds>(now - begin).count();
+            if (now - reported >= std::chrono::milliseconds(TIMER_TICK_MS)) {
+                ReportBusy(spin, work);
+                reported = now;
+            }
+        }
+        if (m_spin > 0) {
+            ReportBusy(spin, work);
+            TRACEI("busy poll total: spinning %llu us, working %llu us",
+                (unsigned long long)m_spinning.load(), (unsigned long long)m_working.load());
+        }
+        return 0;
+    }
+
+    //ش EAGAIN Ϊֹÿһͽҵ
+    //лѹӦʱֹͣȡѹʣں˻壬 EPOLLOUT ٶ
+    //ֵ0 -3 Զ˹رգ <0 /Ƿ/ҵҪϿ
+    int ReadClient(CConnection* conn) {
+        while ((conn->sock->Pending() == 0) && !conn->shed) {//ѻ 503 ӲٶӦдϿ
+            int ret = conn->sock->RecvAppend(conn->input);
+            if (ret == 0) break;//EAGAINں˻Ѷ
+            if (ret < 0) return ret;
+            ret = Dispatch(conn);
+            if (ret < 0) return ret;
+        }
+        return 0;
+    }
+
+    //Ӷг󲢵ýջصǰ׺ǰ
+    int Dispatch(CConnection* conn) {
+        int ret = 0;
+        while (conn->sock->Pending() == 0 && !conn->shed && conn->offset < conn->input.size()) {
+            ssize_t len = CHttpParser::Frame(conn->input.data() + conn->offset, conn->input.size() - conn->offset);
+            if (len < 0) {
+                TRACEW("malformed http request, drop connection %p", conn);
+                ret = -4;
+                break;
+            }
+            if (len == 0) break;//󻹲
+            Buffer request(conn->input.data() + conn->offset, (size_t)len);
+            conn->offset += len;
+            if (!m_recvcallback) continue;
+            if (Overloaded()) {//أֱӻԤɵ 503ͻ˰ Retry-After 
+                if (conn->sock->Send(m_busy) < 0) ret = -5;
+                conn->shed = true;//503  Connection: close֮ˮӦҲ˽
+                break;
+            }
+            m_inflight.fetch_add(1, std::memory_order_relaxed);
+            ReportLoad();
+            int result = m_recvcallback(conn->sock, request);
+            m_inflight.fetch_sub(1, std::memory_order_relaxed);
+            if (m_stats) m_stats->requests.fetch_add(1, std::memory_order_relaxed);
+            ReportLoad();
+            if (result < 0) {
+                ret = -5;
+                break;
+            }
+        }
+        if (conn->shed) {//ʣ
+            conn->input.clear();
+            conn->offset = 0;
+        }
+        size_t rest = conn->input.size() - conn->offset;
+        if (conn->offset > 0) {
+            memmove(conn->input.data(), conn->input.data() + conn->offset, rest);
+            conn->input.resize(rest);
+            conn->offset = 0;
+        }
+        if ((ret == 0) && (rest > HTTP_REQUEST_MAX)) {
+            TRACEW("http request too large (%llu bytes), drop connection %p", (unsigned long long)rest, conn);
+            ret = -6;
+        }
+        return ret;
+    }
+
+    //¹һ epollлѹʱֻ EPOLLOUTٶγɱѹ
+    //ģʽ EPOLLONESHOT ÿζҪһأռģʽֻڹע¼仯ʱ epoll_ctl
+    void Rearm(CReactor* reactor, CConnection* conn, uint32_t fired) {
+        UpdateTimer(reactor, conn);
+        uint32_t events = (conn->sock->Pending() > 0) ? EPOLLOUT : EPOLLIN;
+        if (m_mode == REACTOR_SHARED) {
+            reactor->epoll.Modify(conn->Fd(), events | EPOLLET | EPOLLONESHOT, EpollData(conn->Key()));
+        }
+        else if ((fired & events) == 0) {
+            reactor->epoll.Modify(conn->Fd(), events | EPOLLET, EpollData(conn->Key()));
+        }
+    }
+
+    //ʱֻرնдepoll ģʽյ EPOLLHUPio_uring ģʽ෢ recv  0Ĺر
+    static void OnTimeout(CTimerNode* node) {
+        CConnection* conn = (CConnection*)node->data;
+        TRACEI("connection fd=%d timed out (%s)", conn->Fd(), conn->deadline ? "request" : "idle");
+        shutdown(conn->Fd(), SHUT_RDWR);
+    }
+
+    //ſգڳʱʱִУڵ˵δرգfd ᱻ
+    static void OnDrain(CTimerNode* node) {
+        if (node->Kind() != TIMER_KEEPALIVE) return;
+        shutdown(((CConnection*)node->data)->Fd(), SHUT_RDWR);
+    }
+
+    //ӵǰ׶ѡʱ
+    //лѹӦ -> гʱÿнչ˳ӣ
+    //а -> ֹʱ䣨ֽ㣬ٷͶ˳ӣ
+    // -> keep-alive ʱ
+    void UpdateTimer(CReactor* reactor, CConnection* conn) {
+        unsigned timeout = 0;
+        unsigned kind = TIMER_KEEPALIVE;
+        if (conn->sock->Pending() > 0) {
+            conn->deadline = false;
+            timeout = m_idleTimeout;
+            kind = TIMER_IDLE;
+        }
+        else if (conn->input.size() > 0) {
+            if (conn->deadline) return;
+            conn->deadline = true;
+            timeout = m_headerTimeout;
+            kind = TIMER_HEADER;
+        }
+        else {
+            conn->deadline = false;
+            timeout = m_keepaliveTimeout;
+        }
+        if (timeout > 0) reactor->wheel.Schedule(&conn->timer, timeout, kind);
+        else reactor->wheel.Cancel(&conn->timer);
+        //ſڼѻ 503 ӣӦд꼴ϿȹҶʱټ־ Drain ɨ֮䲻©
+        if ((kind == TIMER_KEEPALIVE) && (m_draining || conn->shed)) shutdown(conn->Fd(), SHUT_RDWR);
+    }
+
+    //==================== io_uring  ====================
+    //̰߳ӽѭ incoming д eventfd̵߳Ǽ
+    void HandOff(CReactor* reactor, CSocketBase* pClient) {
+        reactor->load.fetch_add(1, std::memory_order_relaxed);
+        m_clients.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(reactor->mutex);
+            reactor->incoming.push_back(pClient);
+        }
+        uint64_t one = 1;
+        write(reactor->wake, &one, sizeof(one));
+    }
+
+    int UringThreadFunc(CReactor* reactor)
+    {
+        CUring& ring = reactor->ring;// CreateReactors нã˺ֻɱ߳ύո
+        int ret = 0;
+        UringPoll(reactor, reactor->wake, URING_OP_WAKE);
+        UringPoll(reactor, reactor->wheel, URING_OP_TIMER);
+        SyncAccept(reactor);
+        while (!m_stop) {
+            ret = ring.Submit(1);//ύ󲢵ȴһ¼ÿһϵͳ
+            if ((ret < 0) && (ret != -EINTR) && (ret != -EBUSY) && (ret != -EAGAIN)) {
+                TRACEE("io_uring_enter failed ret=%d", ret);
+                break;
+            }
+            ring.Reap([this, reactor](io_uring_cqe* cqe) { UringComplete(reactor, cqe); });
+            UringRetry(reactor);
+        }
+        return 0;
+    }
+
+    static uint64_t UringTag(UringOp op, uint64_t key) { return ((uint64_t)op << URING_OP_SHIFT) | key; }
+
+    //SQ ʱȰдύ
+    io_uring_sqe* UringSqe(CReactor* reactor) {
+        io_uring_sqe* sqe = reactor->ring.GetSqe();
+        if (sqe == nullptr) {
+            reactor->ring.Submit(0);
+            sqe = reactor->ring.GetSqe();
+        }
+        if (sqe == nullptr) TRACEE("io_uring submission queue full");
+        return sqe;
+    }
+    void UringPoll(CReactor* reactor, int fd, UringOp op) {
+        io_uring_sqe* sqe = UringSqe(reactor);
+        if (sqe) CUring::PrepPoll(sqe, fd, UringTag(op, 0));
+    }
+    void UringAccept(CReactor* reactor) {
+        io_uring_sqe* sqe = UringSqe(reactor);
+        if (sqe == nullptr) return;
+        CUring::PrepAccept(sqe, *m_server, UringTag(URING_OP_ACCEPT, 0));
+        reactor->accepting = true;
+    }
+    //SO_REUSEPORT ģʽ׼״̬ύȡѭĶ෢ accept
+    void SyncAccept(CReactor* reactor) {
+        if (m_server == nullptr) return;
+        bool want = !m_stop && !m_draining && !m_saturated;
+        if (want && !reactor->accepting) {
+            UringAccept(reactor);
+        }
+        else if (!want && reactor->accepting) {//accept  -ECANCELED أʱ accepting
+            io_uring_sqe* sqe = UringSqe(reactor);
+            if (sqe) CUring::PrepCancel(sqe, UringTag(URING_OP_ACCEPT, 0), UringTag(URING_OP_CANCEL, 0));
+        }
+    }
+    void UringRecv(CReactor* reactor, CConnection* conn) {
+        io_uring_sqe* sqe = UringSqe(reactor);
+        if (sqe == nullptr) return;
+        CUring::PrepRecv(sqe, conn->Fd(), UringTag(URING_OP_RECV, conn->Key()));
+        conn->recving = true;
+    }
+    //ŶӵӦΪһӵ send ύϰ˳ͣһȫغύһ
+    // SQE ȫռдܶڰأתΪ; Buffer ԶȲ CQE
+    void UringSend(CReactor* reactor, CConnection* conn) {
+        CUringSocket* sock = (CUringSocket*)conn->sock;
+        size_t count = sock->Prepare();
+        if (count == 0) return;
+        CUring& ring = reactor->ring;
+        if (ring.Space() < count) ring.Submit(0);
+        if (ring.Space() < count) {//ȻŲ£˻Ŷӣһոڳλ
+            sock->Requeue();
+            reactor->stalled.push_back(conn->Key());
+            return;
+        }
+        for (size_t i = 0; i < count; i++) {
+            io_uring_sqe* sqe = ring.GetSqe();
+            const Buffer& data = sock->Sending(i);
+            CUring::PrepSend(sqe, conn->Fd(), data.data(), data.size(), UringTag(URING_OP_SEND, conn->Key()), i + 1 < count);
+        }
+    }
+
+    // SQ ˻ص send ңڼѹرջλõȻ
+    void UringRetry(CReactor* reactor) {
+        if (reactor->stalled.empty()) return;
+        std::vector<uint64_t> stalled;
+        stalled.swap(reactor->stalled);
+        for (uint64_t key : stalled) {
+            CConnection* conn = m_slab.Find(key);
+            if (conn && !conn->closing) UringSend(reactor, conn);
+        }
+    }
+
+    void UringComplete(CReactor* reactor, io_uring_cqe* cqe) {
+        UringOp op = (UringOp)(cqe->user_data >> URING_OP_SHIFT);
+        uint64_t key = cqe->user_data & ((1ull << URING_OP_SHIFT) - 1);
+        bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;//෢ȻЧ
+        switch (op) {
+        case URING_OP_WAKE: {
+            uint64_t value = 0;
+            read(reactor->wake, &value, sizeof(value));
+            std::vector<CSocketBase*> incoming;
+            {
+                std::lock_guard<std::mutex> lock(reactor->mutex);
+                incoming.swap(reactor->incoming);
+            }
+            for (CSocketBase* pClient : incoming) AttachClient(reactor, pClient);
+            SyncAccept(reactor);
+            if (!more) UringPoll(reactor, reactor->wake, URING_OP_WAKE);
+            break;
+        }
+        case URING_OP_TIMER:
+            reactor->wheel.Expire(&CPlayerServer::OnTimeout);
+            Heartbeat();
+            if (!more) UringPoll(reactor, reactor->wheel, URING_OP_TIMER);
+            break;
+        case URING_OP_ACCEPT:
+            if (cqe->res >= 0) {
+                AcceptUring(reactor, cqe->res);
+            }
+            else if (cqe->res != -ECANCELED) {
+                TRACEW("io_uring accept failed res=%d", cqe->res);
+            }
+            if (!more) {
+                reactor->accepting = false;
+                SyncAccept(reactor);
+            }
+            break;
+        case URING_OP_CANCEL:
+            break;
+        case URING_OP_RECV:
+            UringRecvDone(reactor, key, cqe);
+            break;
+        case URING_OP_SEND:
+            UringSendDone(reactor, key, cqe->res);
+            break;
+        }
+    }
+
+    //SO_REUSEPORT ģʽ෢ accept صֱڵǰѭ
+    void AcceptUring(CReactor* reactor, int fd) {
+        CUringSocket* pClient = new CUringSocket(fd);
+        sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        memset(&addr, 0, sizeof(addr));
+        getpeername(fd, (sockaddr*)&addr, &len);
+        int ret = pClient->Init(CSockParam(&addr, SOCK_ISIP));
+        if (ret != 0) {
+            TRACEW("Init failed ret=%d...", ret);
+            delete pClient;
+            return;
+        }
+        reactor->load.fetch_add(1, std::memory_order_relaxed);
+        m_clients.fetch_add(1, std::memory_order_relaxed);
+        AttachClient(reactor, pClient);
+        ReportLoad();
+    }
+
+    //̵߳ǼӲύ෢ recv
+    void AttachClient(CReactor* reactor, CSocketBase* pClient) {
+        BusyPollSocket(pClient);
+        CConnection* conn = m_slab.Acquire(pClient);
+        if (conn == nullptr) {
+            TRACEW("no free connection slot for fd %d (capacity %llu)", (int)(*pClient), (unsigned long long)m_slab.Capacity());
+            delete pClient;
+            reactor->load.fetch_sub(1, std::memory_order_relaxed);
+            m_clients.fetch_sub(1, std::memory_order_relaxed);
+            ReportLoad();
+            return;
+        }
+        conn->deadline = true;
+        reactor->wheel.Schedule(&conn->timer, m_headerTimeout, TIMER_HEADER);
+        UringRecv(reactor, conn);
+        if (m_connectedcallback) {
+            m_connectedcallback(pClient);
+        }
+    }
+
+    void UringRecvDone(CReactor* reactor, uint64_t key, io_uring_cqe* cqe) {
+        CConnection* conn = m_slab.Find(key);
+        if (cqe->flags & IORING_CQE_F_BUFFER) {//ںѡĻ黹
+            uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            if (conn && (cqe->res > 0) && !conn->closing) {
+                conn->input.append(reactor->ring.BufferAddr(bid), cqe->res);
+            }
+            reactor->ring.RecycleBuffer(bid);
+        }
+        if (conn == nullptr) return;
+        if (!(cqe->flags & IORING_CQE_F_MORE)) conn->recving = false;
+
+        if (cqe->res > 0) {
+            if (!conn->closing && (UringDispatch(reactor, conn) < 0)) UringClose(conn);
         }
+        else if (cqe->res == 0) {
+            TRACEI("Client disconnected fd=%d", conn->Fd());
+            UringClose(conn);
+        }
+        else if (cqe->res != -ENOBUFS) {//ENOBUFSʱ꣬ںύ
+            TRACEE("io_uring recv failed fd=%d res=%d", conn->Fd(), cqe->res);
+            UringClose(conn);
+        }
+        if (!conn->recving && !conn->closing) UringRecv(reactor, conn);
+        UringRelease(reactor, conn);
+    }
+
+    void UringSendDone(CReactor* reactor, uint64_t key, int res) {
+        CConnection* conn = m_slab.Find(key);
+        if (conn == nullptr) return;
+        CUringSocket* sock = (CUringSocket*)conn->sock;
+        if (sock->Complete(res) < 0) {
+            if (!conn->closing) TRACEE("io_uring send failed fd=%d res=%d", conn->Fd(), res);
+            UringClose(conn);
+        }
+        else if ((sock->InFlight() == 0) && !conn->closing) {
+            //꣺ѹڼڶ󣬲ύһ
+            if (UringDispatch(reactor, conn) < 0) UringClose(conn);
+        }
+        UringRelease(reactor, conn);
+    }
+
+    int UringDispatch(CReactor* reactor, CConnection* conn) {
+        int ret = Dispatch(conn);
+        if (ret < 0) return ret;
+        UringSend(reactor, conn);
+        UpdateTimer(reactor, conn);
         return 0;
     }
 
+    //رնд; recv/send 췵أͷ UringRelease
+    void UringClose(CConnection* conn) {
+        if (conn->closing) return;
+        conn->closing = true;
+        shutdown(conn->Fd(), SHUT_RDWR);
+    }
+
+    //;ȫغܹ黹λں˿Գзͻ
+    void UringRelease(CReactor* reactor, CConnection* conn) {
+        if (!conn->closing || conn->recving || (((CUringSocket*)conn->sock)->InFlight() > 0)) return;
+        reactor->wheel.Cancel(&conn->timer);
+        reactor->load.fetch_sub(1, std::memory_order_relaxed);
+        m_clients.fetch_sub(1, std::memory_order_relaxed);
+        m_slab.Release(conn);
+        ReportLoad();
+    }
+
 private:
-    CEpoll m_epoll;
-    std::map<int, CSocketBase*> m_mapClients;
+    std::vector<CReactor*> m_reactors; //¼ѭģʽֻһ
+    CConnectionSlab m_slab;            // fd Ӳ
+    std::atomic<int> m_clients{ 0 };   //
+    std::atomic<unsigned> m_next{ 0 }; //ѯα
+    CSocketBase* m_server = nullptr; // SO_REUSEPORT ģʽ±̵ļ׽
     CThreadPool m_pool;
     unsigned m_count = 0;
+    ReactorMode m_mode;
+    EventBackend m_backend;
+    std::atomic<bool> m_stop{ false };
+    std::atomic<bool> m_draining{ false }; //յſ
+    std::atomic<int> m_inflight{ 0 };      //ҵд
+    std::atomic<int> m_dbQueue{ 0 };       //Ŷӵȴݿ
+    std::atomic<bool> m_saturated{ false }; //ѴﵽӲ
+    std::mutex m_admissionMutex;           //л״̬лԼ Drain ֮䣩
+    Buffer m_busy;                         //Ԥɵ 503 Ӧ
+    std::mutex m_drainMutex;
+    std::condition_variable m_drainCond;   //ſڼӹ
+    unsigned m_headerTimeout = HTTP_HEADER_TIMEOUT;       //룬0 ʾ
+    unsigned m_keepaliveTimeout = HTTP_KEEPALIVE_TIMEOUT;
+    unsigned m_idleTimeout = HTTP_IDLE_TIMEOUT;
+    unsigned m_spin = 0;                   //æѯתԤ㣨΢룩0 ʾֱ
+    unsigned m_busypoll = 0;               //ӵ SO_BUSY_POLL΢룩
+    bool m_preferBusyPoll = false;         //Ӽ SO_PREFER_BUSY_POLL
+    std::atomic<bool> m_busyPollFailed{ false };
+    std::atomic<uint64_t> m_spinning{ 0 }; //ѭۼƿתʱ䣨΢룩
+    std::atomic<uint64_t> m_working{ 0 };  //ѭۼƴ¼ʱ䣨΢룩
+    CProcess* m_proc = nullptr; // 븸̵ͨϱ
     CDatabaseClient* m_db;
     std::mutex m_dbMutex;
 };
@@ -1,43 +1,133 @@
 #include "CServer.h"
 #include "Logger.h"
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <chrono>
 
 CServer::CServer()
 {
-    m_server = nullptr;
     m_business = nullptr;
 }
 
 int CServer::Init(CBusiness* business, const Buffer& ip, short port)
+{
+    return Init(business, CServerParam(ip, port));
+}
+
+int CServer::Init(CBusiness* business, const CServerParam& param)
 {
     if (business == nullptr) return -1;
     m_business = business;
+    m_param = param;
 
-    int ret = 0;
-    // [步骤 1]: 注册子进程的入口点
-    ret = m_process.SetEntryFunction(&CBusiness::BusinessProcess, m_business,&m_process);
-    if (ret != 0) return -2;
+    // 退出信号改由 Run 中的 signalfd 读取：必须在 fork 子进程、启动线程之前屏蔽
+    sigset_t set;
+    int ret = BlockSignals(&set);
+    if (ret != 0) return -11;
+    m_signal = signalfd(-1, &set, SFD_CLOEXEC);
+    if (m_signal == -1) return -12;
 
-	// [步骤 2]: 创建子进程,子进程进入业务循环
-    ret = m_process.CreateSubProcess();
-    if (ret != 0) return -3;
+    // [步骤 0]: SO_REUSEPORT 模式下由子进程自行监听，fork 前把监听参数交给业务模块
+    if ((m_param.mode == SERVER_REUSEPORT) && (m_param.port > 0)) {
+        CSockParam listen(m_param.ip, m_param.port,
+            SOCK_ISSERVER | SOCK_ISIP | SOCK_ISNONBLOCK | SOCK_ISREUSE | SOCK_ISREUSEPORT);
+        listen.backlog = m_param.backlog;
+        listen.option = m_param.option;
+        m_business->setListenParam(listen);
+    }
+    m_business->setLimitParam(m_param.limit);
+    //TLS 上下文同样在 fork 之前创建：各子进程共用一组票据密钥，重连落到哪个子进程都能恢复会话
+    if (m_param.tls.cert.size() > 0) {
+        ret = m_tls.Init(m_param.tls);
+        if (ret != 0) {
+            TRACEE("tls init failed ret=%d", ret);
+            return -16;
+        }
+        m_business->setTlsContext(m_tls);
+    }
 
-	// [步骤 3]: 启动线程池
-    ret = m_pool.Start(2);
+    // [步骤 1/2]: 注册子进程的入口点并逐个创建子进程,子进程进入业务循环
+    if (m_param.workers == 0) m_param.workers = 1;
+    if (m_param.batch == 0) m_param.batch = 1;
+    if (m_param.batch > SOCKET_BATCH_MAX) m_param.batch = SOCKET_BATCH_MAX;
+    //SO_REUSEPORT 模式下子进程一启动就自己 accept，无法只预热不接活
+    if (m_param.mode == SERVER_REUSEPORT) m_param.standby = 0;
+    //控制面必须在 fork 之前映射，子进程才能继承同一块共享内存
+    ret = m_control.Init(m_param.workers + m_param.standby);
+    if (ret != 0) return -13;
+    //备用进程排在业务子进程之后，同样进入业务循环（连好数据库），只是不参与分配
+    for (size_t i = 0; i < m_param.workers + m_param.standby; i++) {
+        WorkerSlot* worker = new WorkerSlot();
+        m_workers.push_back(worker);
+        worker->stats = m_control.Stats(i);
+        worker->standby = (i >= m_param.workers);
+        ret = worker->process.SetEntryFunction(&CServer::WorkerProcess, this, i);
+        if (ret != 0) return -2;
+    }
+    //重启在接收线程运行时发生：交给此刻（槽位已建好、还没有任何线程）fork 出的 zygote 去做
+    ret = m_zygote.Start(&CServer::RespawnedWorker, this);
+    if (ret != 0) return -17;
+    for (WorkerSlot* worker : m_workers) {
+        worker->state.started = std::chrono::steady_clock::now();
+        ret = worker->process.CreateSubProcess();
+        if (ret != 0) return -3;
+    }
+
+    // 子进程直接 accept，没有本地套接字路径时父进程无需监听与转发
+    if ((m_param.mode == SERVER_REUSEPORT) && m_param.paths.empty()) {
+        m_running = true;
+        return 0;
+    }
+
+	// [步骤 3]: 启动线程池，接收线程避开业务核
+    CPoolParam acceptor("ps-accept");
+    acceptor.cpus = CCpuPolicy(m_param.reservecpus).SystemCpus();
+    ret = m_pool.Start(2, acceptor);
     if (ret != 0) return -4;
 
 	// [步骤 4]: 初始化 Epoll 多路复用器
     ret = m_epoll.Create(2);
     if (ret != 0) return -5;
 
-    // [步骤 5]: 构建并初始化服务端监听 Socket
-    m_server = new CSocket();
-    if (m_server == nullptr) return -6;
-    ret = m_server->Init(CSockParam(ip, port, SOCK_ISSERVER | SOCK_ISIP | SOCK_ISNONBLOCK| SOCK_ISREUSE));
-    if (ret != 0) return -7;
+    // [步骤 5]: 构建并初始化服务端监听 Socket：TCP（SO_REUSEPORT 模式下由子进程监听）与各本地套接字路径
+    if ((m_param.mode != SERVER_REUSEPORT) && (m_param.port > 0)) {
+        CSockParam listen(m_param.ip, m_param.port, SOCK_ISSERVER | SOCK_ISIP | SOCK_ISNONBLOCK | SOCK_ISREUSE);
+        listen.backlog = m_param.backlog;
+        listen.option = m_param.option;
+        CSocketBase* server = new CSocket();
+        m_servers.push_back(server);
+        ret = server->Init(listen);
+        if (ret != 0) return -7;
+    }
+    for (const Buffer& path : m_param.paths) {
+        if (path.size() == 0 || path.size() >= sizeof(sockaddr_un::sun_path)) return -14;
+        CSockParam listen(path, SOCK_ISSERVER | SOCK_ISNONBLOCK);
+        listen.backlog = m_param.backlog;
+        CSocketBase* server = new CSocket();
+        m_servers.push_back(server);
+        ret = server->Init(listen);
+        if (ret != 0) return -7;
+        if (chmod(path, (mode_t)m_param.pathmode) != 0) return -15;
+    }
+    if (m_servers.empty()) return -6;
 
 	// [步骤 6]: 将服务端 Socket 添加到 Epoll 监听列表，等待连接事件
-    ret = m_epoll.Add(*m_server, EpollData((void*)m_server));
-    if (ret != 0) return -8;
+    //          drain 模式下由各接收线程在自己的 epoll 中以 EPOLLEXCLUSIVE 注册
+    if (!m_param.drain) {
+        for (CSocketBase* server : m_servers) {
+            ret = m_epoll.Add(*server, EpollData((void*)server));
+            if (ret != 0) return -8;
+        }
+        m_acceptors.push_back(&m_epoll);
+    }
+
+    // 子进程通过 socketpair 回报负载，一次只由一个线程读取
+    for (WorkerSlot* worker : m_workers) {
+        ret = m_epoll.Add(worker->process.LocalPipe(), EpollData((void*)worker), EPOLLIN | EPOLLONESHOT);
+        if (ret != 0) return -10;
+    }
 
 	// [步骤 7]: 启动线程池工作线程，处理 Epoll 事件
     for (size_t i = 0; i < m_pool.Size(); i++) {
@@ -45,72 +135,485 @@ int CServer::Init(CBusiness* business, const Buffer& ip, short port)
         if (ret != 0) return -9;
     }
 
+    m_running = true;
     return 0;
 }
 
-int CServer::Run()
+int CServer::BlockSignals(sigset_t* set)
 {
-    //TODO:std::condition_variable
-    while (m_server != nullptr) {
-        usleep(10);
-    }
+    sigset_t local;
+    if (set == nullptr) set = &local;
+    sigemptyset(set);
+    sigaddset(set, SIGTERM);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGHUP);
+    sigaddset(set, SIGCHLD);
+    if (pthread_sigmask(SIG_BLOCK, set, nullptr) != 0) return -1;
     return 0;
 }
 
-int CServer::Close()
+int CServer::Supervise(CProcess* proc)
 {
-    //停止Run() 和 ThreadFunc()
-    if (m_server) {
-        CSocketBase* sock = m_server;
-        m_server = nullptr;
+    if (proc == nullptr || proc->Pid() <= 0) return -1;
+    SupervisedProcess item;
+    item.process = proc;
+    item.state.started = std::chrono::steady_clock::now();
+    m_supervised.push_back(item);
+    return 0;
+}
 
-        m_epoll.Del(*sock);
-        delete sock;
+int CServer::Run()
+{
+    if (m_signal == -1) return -1;
+    int ret = 0;
+    while (m_running) {
+        //没有待重启、待巡检的事时一直阻塞，不占用 CPU；否则最多等到最近的一项
+        int timeout = RespawnWorkers();
+        int check = CheckWorkers();
+        if (timeout < 0 || (check >= 0 && check < timeout)) timeout = check;
+        pollfd pfd = { m_signal, POLLIN, 0 };
+        int n = poll(&pfd, 1, timeout);
+        if (n == 0) continue;
+        if (n == -1 && errno == EINTR) continue;
+        signalfd_siginfo info;
+        ssize_t len = (n > 0) ? read(m_signal, &info, sizeof(info)) : -1;
+        if (len == -1 && errno == EINTR) continue;
+        if (len != sizeof(info)) {
+            TRACEE("read signalfd failed len=%d errno=%d", (int)len, errno);
+            ret = -2;
+            break;
+        }
+        if (info.ssi_signo == SIGCHLD) {//子进程退出：回收，连接不再分给它，随后由 RespawnWorkers 重新拉起
+            ReapWorkers();
+            continue;
+        }
+        TRACEI("signal %d received, shutting down", (int)info.ssi_signo);
+        break;
     }
-	//关闭子进程和线程池
+    Close();
+    return ret;
+}
+
+int CServer::Close()
+{
+    //停止 Run() 和 ThreadFunc()：先停掉接收线程，再关闭监听套接字，避免线程仍在使用它
+    m_running = false;
     m_epoll.Close();
-    m_process.SendFD(-1);
     m_pool.Close();
+    for (CSocketBase* server : m_servers) {
+        delete server;//本地套接字在 Close 中删除路径
+    }
+    m_servers.clear();
+    //通知子进程排空在途请求，等它们退出后回收
+    for (WorkerSlot* worker : m_workers) {
+        if (!worker->exited) worker->process.SendDrain(m_param.grace);
+    }
+    if (!m_workers.empty()) WaitWorkers(m_param.grace + 1000);
+    for (WorkerSlot* worker : m_workers) {
+        delete worker;
+    }
+    m_workers.clear();
+    m_supervised.clear();
+    m_zygote.Close();
+    m_control.Close();
+    if (m_signal != -1) {
+        close(m_signal);
+        m_signal = -1;
+    }
     return 0;
 }
 
+//子进程退出时确定重启时间：启动后很快又退出的按指数退避，运行够久的立即重启
+static void ScheduleRespawn(RespawnState& state)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - state.started < std::chrono::milliseconds(RESPAWN_STABLE)) state.failures++;
+    else state.failures = 0;
+    unsigned delay = 0;
+    if (state.failures > 0) {
+        unsigned shift = state.failures - 1;
+        delay = RESPAWN_DELAY_MIN << (shift > 6 ? 6 : shift);
+        if (delay > RESPAWN_DELAY_MAX) delay = RESPAWN_DELAY_MAX;
+    }
+    state.respawn = now + std::chrono::milliseconds(delay);
+}
+
+//非阻塞回收 pid，返回 true 表示已退出
+static bool ReapProcess(pid_t pid, const char* name)
+{
+    int status = 0;
+    pid_t ret = (pid > 0) ? waitpid(pid, &status, WNOHANG) : -1;
+    if (ret == 0) return false;
+    if (ret == pid) {
+        if (WIFSIGNALED(status)) TRACEW("%s pid=%d killed by signal %d", name, (int)pid, WTERMSIG(status));
+        else TRACEI("%s pid=%d exited with %d", name, (int)pid, WEXITSTATUS(status));
+    }
+    return true;
+}
+
+size_t CServer::ReapWorkers()
+{
+    size_t alive = 0;
+    for (WorkerSlot* worker : m_workers) {
+        if (worker->exited) continue;
+        if (!ReapProcess(worker->process.Pid(), "worker")) {
+            alive++;
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->exited = true;
+            worker->down = true;
+        }
+        ScheduleRespawn(worker->state);
+        if (worker->standby) continue;
+        //备用进程已连好数据库，直接顶替；退出的槽位重启后转为备用
+        for (WorkerSlot* spare : m_workers) {
+            if (spare->standby && !spare->exited) {
+                spare->standby = false;
+                worker->standby = true;
+                TRACEI("standby pid=%d takes over", (int)spare->process.Pid());
+                break;
+            }
+        }
+    }
+    for (SupervisedProcess& proc : m_supervised) {
+        if (proc.exited || !ReapProcess(proc.process->Pid(), "process")) continue;
+        proc.exited = true;
+        ScheduleRespawn(proc.state);
+    }
+    return alive;
+}
+
+int CServer::RespawnWorkers()
+{
+    if (!m_running) return -1;
+    auto now = std::chrono::steady_clock::now();
+    int timeout = -1;
+    //已到重启时间返回 true，否则把剩余时间计入 timeout
+    auto due = [&](const RespawnState& state) {
+        long long left = std::chrono::duration_cast<std::chrono::milliseconds>(state.respawn - now).count();
+        if (left <= 0) return true;
+        if (timeout < 0 || left < timeout) timeout = (int)left;
+        return false;
+    };
+    for (size_t i = 0; i < m_workers.size(); i++) {
+        WorkerSlot* worker = m_workers[i];
+        if (!worker->exited || !due(worker->state)) continue;
+        int ret = SpawnWorker(worker, i);
+        if (ret == 0) continue;
+        TRACEE("respawn worker failed ret=%d errno=%d", ret, errno);
+        ScheduleRespawn(worker->state);
+        due(worker->state);
+    }
+    for (SupervisedProcess& proc : m_supervised) {
+        if (!proc.exited || !due(proc.state)) continue;
+        proc.state.started = std::chrono::steady_clock::now();
+        int ret = proc.process->CreateSubProcess();
+        if (ret == 0) {
+            proc.exited = false;
+            TRACEI("process pid=%d respawned", (int)proc.process->Pid());
+            continue;
+        }
+        TRACEE("respawn process failed ret=%d errno=%d", ret, errno);
+        ScheduleRespawn(proc.state);
+        due(proc.state);
+    }
+    return timeout;
+}
+
+int CServer::SpawnWorker(WorkerSlot* worker, size_t index)
+{
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    //旧通道可能还被其他进程持有，先显式摘下，免得过期事件指向新通道
+    if ((m_epoll != -1) && (worker->process.LocalPipe() != -1)) {
+        m_epoll.Del(worker->process.LocalPipe());
+    }
+    worker->state.started = std::chrono::steady_clock::now();
+    worker->stats->Reset(CControlPlane::Now());//上一个进程留下的计数作废
+    int ret = worker->process.CreateSubProcess(m_zygote, (uint32_t)index);
+    if (ret != 0) return -1;
+    worker->exited = false;
+    worker->down = false;
+    TRACEI("worker pid=%d respawned%s", (int)worker->process.Pid(), worker->standby ? " as standby" : "");
+    //SO_REUSEPORT 模式没有 m_epoll，子进程不经父进程转发
+    if (m_epoll != -1) {
+        ret = m_epoll.Add(worker->process.LocalPipe(), EpollData((void*)worker), EPOLLIN | EPOLLONESHOT);
+        if (ret != 0) return -2;//子进程已在运行，只是收不到负载上报
+    }
+    return 0;
+}
+
+void CServer::WaitWorkers(unsigned timeout)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while (ReapWorkers() > 0) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) break;
+        //SIGCHLD 经 signalfd 唤醒；排空期间再收到的退出信号一并读掉
+        pollfd pfd = { m_signal, POLLIN, 0 };
+        if (poll(&pfd, 1, (int)left) > 0) {
+            signalfd_siginfo info;
+            read(m_signal, &info, sizeof(info));
+        }
+    }
+    for (WorkerSlot* worker : m_workers) {
+        if (worker->exited) continue;
+        TRACEW("worker pid=%d did not drain in time, killing it", (int)worker->process.Pid());
+        kill(worker->process.Pid(), SIGKILL);
+        waitpid(worker->process.Pid(), nullptr, 0);
+        worker->exited = true;
+    }
+}
+
+int CServer::RespawnedWorker(uint32_t index, int channel)
+{
+    m_workers[index]->process.Attach(channel);
+    return WorkerProcess(index);
+}
+
+int CServer::WorkerProcess(size_t index)
+{
+    m_zygote.Detach();
+    //fork 时继承了兄弟进程（重启时包括之后的槽位）和受监管进程的父进程端，不关掉的话父进程退出后它们收不到 EOF
+    for (size_t i = 0; i < m_workers.size(); i++) {
+        if (i != index) m_workers[i]->process.ClosePipe();
+    }
+    for (SupervisedProcess& proc : m_supervised) {
+        proc.process->ClosePipe();
+    }
+    //重启时父进程已在监听：子进程不持有监听套接字，父进程退出后端口即可释放
+    //只关 fd，不能调用 Close：本地套接字的 Close 会删掉父进程仍在使用的路径
+    for (CSocketBase* server : m_servers) {
+        close(*server);
+    }
+    //退出信号保持屏蔽：子进程只听父进程经通道发来的排空命令，父进程异常退出时通道 EOF
+    close(m_signal);
+    m_signal = -1;
+    m_business->setStats(m_workers[index]->stats);
+    //各子进程的业务线程按全局序号在业务核上依次铺开，不挤在同几个核上
+    CPoolParam io("ps-io");
+    io.cpus = CCpuPolicy(m_param.reservecpus).BusinessCpus();
+    io.first = (unsigned)index * m_business->Threads();
+    m_business->setPoolParam(io);
+    return m_business->BusinessProcess(&m_workers[index]->process);
+}
+
+bool CServer::Saturated()
+{
+    WorkerSlot* worker = PickWorker();
+    if (worker == nullptr) return false;
+    if (worker->stats->saturated.load(std::memory_order_relaxed)) return true;
+    int load = worker->stats->connections.load(std::memory_order_relaxed);
+    return (m_param.limit.connhard > 0) && (load >= (int)m_param.limit.connhard);
+}
+
+bool CServer::Hung(const WorkerSlot* worker, uint64_t now) const
+{
+    if (m_param.hang == 0) return false;
+    uint64_t beat = worker->stats->heartbeat.load(std::memory_order_relaxed);
+    return (now > beat) && (now - beat > m_param.hang);
+}
+
+int CServer::CheckWorkers()
+{
+    //兜底：饱和解除的通知因通道繁忙被丢弃时，靠巡检读控制面恢复 accept
+    if (m_paused && !Saturated()) PauseAccept(false);
+    if (m_param.hang == 0) return m_paused ? HEALTH_CHECK_INTERVAL : -1;
+    uint64_t now = CControlPlane::Now();
+    for (WorkerSlot* worker : m_workers) {
+        if (worker->exited || !Hung(worker, now)) continue;
+        TRACEE("worker pid=%d heartbeat lost for %llu ms, killing it", (int)worker->process.Pid(),
+            (unsigned long long)(now - worker->stats->heartbeat.load(std::memory_order_relaxed)));
+        kill(worker->process.Pid(), SIGKILL);//随后经 SIGCHLD 回收并重启
+        worker->stats->heartbeat.store(now, std::memory_order_relaxed);//回收之前不重复处理
+    }
+    return HEALTH_CHECK_INTERVAL;
+}
+
+void CServer::PauseAccept(bool pause)
+{
+    std::lock_guard<std::mutex> lock(m_acceptMutex);
+    if ((m_paused == pause) || m_servers.empty()) return;
+    m_paused = pause;
+    //epoll_ctl 本身线程安全，可以直接改其他线程的局部 epoll
+    uint32_t events = m_param.drain ? (EPOLLIN | EPOLLEXCLUSIVE) : EPOLLIN;
+    for (CEpoll* epoll : m_acceptors) {
+        for (CSocketBase* server : m_servers) {
+            if (pause) epoll->Del(*server);
+            else epoll->Add(*server, EpollData((void*)server), events);
+        }
+    }
+    if (pause) TRACEW("all workers saturated, accept paused");
+    else TRACEI("accept resumed");
+}
+
+WorkerSlot* CServer::PickWorker()
+{
+    //只读共享内存：在线连接数与心跳都由子进程直接写入，不需要等负载上报
+    WorkerSlot* target = nullptr;
+    int min = 0;
+    uint64_t now = (m_param.hang > 0) ? CControlPlane::Now() : 0;
+    for (WorkerSlot* worker : m_workers) {
+        if (worker->standby || worker->down) continue;
+        if (Hung(worker, now)) continue;//卡死的子进程不再接新连接
+        int load = worker->stats->connections.load(std::memory_order_relaxed);
+        if (target == nullptr || load < min) {
+            target = worker;
+            min = load;
+        }
+    }
+    return target;
+}
+
+CSocketBase* CServer::FindServer(void* ptr)
+{
+    for (CSocketBase* server : m_servers) {
+        if (server == ptr) return server;
+    }
+    return nullptr;
+}
+
+int CServer::HandoffClients(CSocketBase* server)
+{
+    //硬上限：不再 accept，新连接留在内核队列（满了由内核丢 SYN），等子进程回落
+    if (Saturated()) {
+        PauseAccept(true);
+        return 0;
+    }
+    CSocketBase* clients[SOCKET_BATCH_MAX];
+    int fds[SOCKET_BATCH_MAX];
+    sockaddr_in addrins[SOCKET_BATCH_MAX];
+    size_t count = 0;
+    while (count < m_param.batch) {
+        CSocketBase* pClient = nullptr;
+        int ret = server->Link(&pClient);//// 执行 Accept 取出新连接
+        if (ret != 0 || pClient == nullptr) break;
+        clients[count] = pClient;
+        fds[count] = (int)(*pClient);// 获取底层套接字句柄
+        addrins[count] = *(const sockaddr_in*)(*pClient);
+        //本地套接字没有 IP 地址：把地址族标成 AF_UNIX，子进程据此改用 SO_PEERCRED 识别对端
+        if (pClient->IsLocal()) addrins[count].sin_family = AF_UNIX;
+        count++;
+    }
+    if (count == 0) return 0;
+
+    // 【核心跨进程移交流程】
+    //将本次取到的一批句柄一次性发送给负载最低的子进程,进行业务处理，父进程不再管理这些连接
+    //子进程刚崩溃、还没被回收时发送会失败：把它标记为断开，换一个子进程重试，这批连接不丢
+    WorkerSlot* worker = nullptr;
+    int ret = -1;
+    for (size_t attempt = 0; attempt < m_workers.size(); attempt++) {
+        worker = PickWorker();
+        if (worker == nullptr) break;
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        ret = worker->exited ? -1 : worker->process.SendSockets(fds, addrins, count);
+        if (ret == 0) break;
+        TRACEW("handoff to worker pid=%d failed ret=%d, retrying", (int)worker->process.Pid(), ret);
+        worker->down = true;
+    }
+    for (size_t i = 0; i < count; i++) {
+        delete clients[i];
+    }
+    if (ret != 0) {
+        TRACEE("send %d clients failed! ret=%d", (int)count, ret);
+        return -1;
+    }
+    worker->stats->connections.fetch_add((int)count, std::memory_order_relaxed);//子进程登记后会写入实际值
+    return (int)count;
+}
+
+void CServer::UpdateWorker(const epoll_event& event)
+{
+    WorkerSlot* worker = (WorkerSlot*)event.data.ptr;
+    //与重启互斥：重启会替换通道；已退出的等重启时登记新通道
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    if (worker->exited) return;
+    //负载本身从控制面读取，通道上的消息只是饱和状态变化的提醒
+    int load = 0;
+    int ret = worker->process.RecvLoad(load);
+    if (ret == 0 && m_paused && !Saturated()) PauseAccept(false);
+    //只以 EOF 判断断开：HUP 事件可能是重启前旧通道留下的，此时读到的是新通道
+    if (ret == -3) {
+        TRACEE("worker pid=%d disconnected!", (int)worker->process.Pid());
+        worker->down = true;
+        m_epoll.Del(worker->process.LocalPipe());
+        return;
+    }
+    m_epoll.Modify(worker->process.LocalPipe(), EPOLLIN | EPOLLONESHOT, EpollData((void*)worker));
+}
+
 int CServer::ThreadFunc()
 {
-    TRACEI("epoll %d server %p", (int)m_epoll, m_server);
+    TRACEI("epoll %d servers %d", (int)m_epoll, (int)m_servers.size());
     EPEvents events;
+    EPEvents reports;
+    // drain 模式：本线程独占一个 epoll，监听套接字以 EPOLLEXCLUSIVE 注册，
+    // 新连接到来时只唤醒一个接收线程，由它 accept4 直到 EAGAIN；
+    // 共享 epoll（子进程负载上报）嵌套进来，epoll 句柄不支持 EPOLLEXCLUSIVE
+    CEpoll local;
+    CEpoll* epoll = &m_epoll;
+    if (m_param.drain) {
+        int ret = local.Create(2);
+        if (ret == 0) ret = local.Add(m_epoll, EpollData((void*)&m_epoll), EPOLLIN);
+        //直接监听 m_epoll 的唤醒 eventfd：Close 关掉 m_epoll 后嵌套的就绪会随之消失，本线程可能因此错过唤醒
+        if (ret == 0) ret = local.Add(m_epoll.WakeFd(), EpollData((void*)&m_epoll), EPOLLIN);
+        if (ret == 0) {//登记后由 PauseAccept 统一摘下/挂回监听套接字
+            std::lock_guard<std::mutex> lock(m_acceptMutex);
+            for (size_t i = 0; (i < m_servers.size()) && (ret == 0) && !m_paused; i++) {
+                ret = local.Add(*m_servers[i], EpollData((void*)m_servers[i]), EPOLLIN | EPOLLEXCLUSIVE);
+            }
+            if (ret == 0) m_acceptors.push_back(&local);
+        }
+        if (ret != 0) {
+            TRACEE("drain epoll init failed ret=%d errno=%d", ret, errno);
+            return -1;
+        }
+        epoll = &local;
+    }
 
-    while ((m_epoll != -1) && (m_server != nullptr)) {
-        ssize_t size = m_epoll.WaitEvents(events,500);
+    while (m_epoll != -1) {
+        ssize_t size = epoll->WaitEvents(events);//Close 时由 m_epoll 的唤醒通道返回
         if (size < 0) break;
       
         for (ssize_t i = 0; i < size; i++) {
             //TRACEI("size=%d event %08X", (int)size, events[0].events);
+            //共享 epoll 就绪：取出子进程的负载上报
+            if (events[i].data.ptr == &m_epoll) {
+                ssize_t count = m_epoll.WaitEvents(reports, 0);
+                for (ssize_t j = 0; j < count; j++) {
+                    UpdateWorker(reports[j]);
+                }
+                continue;
+            }
+            //子进程的饱和状态通知
+            CSocketBase* server = FindServer(events[i].data.ptr);
+            if (server == nullptr) {
+                UpdateWorker(events[i]);
+                continue;
+            }
             if (events[i].events & EPOLLERR) {
                 break;
             }
             //处理可读事件
             if (events[i].events & EPOLLIN) {
-                if (!m_server) continue;
-
-                CSocketBase* pClient = nullptr;
-                int ret = m_server->Link(&pClient);//// 执行 Accept 取出新连接
-                if (ret != 0 || pClient == nullptr) continue;
-
-                int client_fd = (int)(*pClient);// 获取底层套接字句柄
-
-                // 【核心跨进程移交流程】
-				//将句柄发送给子进程,进行业务处理，父进程不再管理该连接
-                ret = m_process.SendSocket(*pClient, *pClient);
-                delete pClient;
-                pClient = nullptr;
-
-                if (ret != 0) {
-                    TRACEE("send client %d failed!", client_fd);
-                    continue;
+                int count = HandoffClients(server);
+                //drain 模式：整批取满说明队列里可能还有，继续取直到 EAGAIN
+                while (m_param.drain && count == (int)m_param.batch) {
+                    count = HandoffClients(server);
                 }
             }
         }
     }
+    if (epoll == &local) {
+        std::lock_guard<std::mutex> lock(m_acceptMutex);
+        for (size_t i = 0; i < m_acceptors.size(); i++) {
+            if (m_acceptors[i] == &local) {
+                m_acceptors.erase(m_acceptors.begin() + i);
+                break;
+            }
+        }
+    }
     TRACEI("服务器终止");
     return 0;
 }
@@ -5,6 +5,34 @@
 #include "ThreadPool.h"
 #include "Process.h"
 #include "Function.h"
+#include "Control.h"
+#include "Tls.h"
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <signal.h>
+
+#define HEALTH_CHECK_INTERVAL 1000 // Run Ѳͣ״̬ļ룩
+#define RESPAWN_DELAY_MIN 100   // ӽܿ˳ʱ״ӳ٣룩֮η
+#define RESPAWN_DELAY_MAX 5000  // ӳޣ룩ѭռ CPU
+#define RESPAWN_STABLE 1000     // гʱ룩ɹ´
+
+//׼Ʋﵽֱӻ 503 ϿﵽӲͣ accept0 ʾ
+class CLimitParam {
+public:
+    CLimitParam() : connsoft(0), connhard(0), requestsoft(0), requesthard(0),
+        dbsoft(0), dbhard(0), retryafter(1) {}
+
+public:
+    unsigned connsoft;    // ÿҵӽ̵
+    unsigned connhard;
+    unsigned requestsoft; // ÿҵӽڴ
+    unsigned requesthard;
+    unsigned dbsoft;      // ÿҵӽŶӵȴݿ
+    unsigned dbhard;
+    unsigned retryafter;  // 503 Ӧ Retry-After룩
+};
 
 /**
  * @brief ҵ߼ĳ
@@ -28,9 +56,7 @@ public:
     template <typename _FUNCTION_, typename... _ARGS_>
     int setConnectedCallback(_FUNCTION_ func, _ARGS_... args)
     {
-        delete m_connectedcallback;
-        m_connectedcallback = new CConnectedFunction<_FUNCTION_, _ARGS_...>(func, args...);
-        if (m_connectedcallback == nullptr) return -1;
+        m_connectedcallback = CConnectedFunction(func, args...);
         return 0;
     }
 
@@ -38,16 +64,89 @@ public:
     template <typename _FUNCTION_, typename... _ARGS_>
     int setRecvCallback(_FUNCTION_ func, _ARGS_... args)
     {
-        delete m_recvcallback;
-        m_recvcallback = new CRecvFunction<_FUNCTION_, _ARGS_...>(func, args...);
-        if (m_recvcallback == nullptr) return -1;
+        m_recvcallback = CRecvFunction(func, args...);
         return 0;
     }
 
+    //ӽмĵַSO_REUSEPORT ģʽ fork ֮ǰ
+    void setListenParam(const CSockParam& param) { m_listen = param; }
+    //׼ֵ fork ֮ǰ
+    void setLimitParam(const CLimitParam& limit) { m_limit = limit; }
+    //ñڹе״̬ۣӽ̽ BusinessProcess ֮ǰ
+    void setStats(WorkerStats* stats) { m_stats = stats; }
+    //ҵ̳߳ص߳ CPU 󶨣ӽ̽ BusinessProcess ֮ǰ
+    void setPoolParam(const CPoolParam& param) { m_poolparam = param; }
+    // TLS ģ fork ֮ǰӽ̹ƱԿnullptr ʾ
+    void setTlsContext(SSL_CTX* ctx) { m_tls = ctx; }
+    //ҵ߳̾ݴ˴ӽ߳ҵϵ
+    virtual unsigned Threads() const { return 1; }
+
 protected:
     CBusiness() = default;
-    CFunctionBase* m_connectedcallback = nullptr;
-    CFunctionBase* m_recvcallback = nullptr;
+    CConnectedFunction m_connectedcallback; // ص (CSocketBase*) ڰ󶨲֮
+    CRecvFunction      m_recvcallback;      // ص (CSocketBase*, const Buffer&) ڰ󶨲֮
+    CSockParam     m_listen; // attr  SOCK_ISSERVER ʱӽ bind/acceptֻոƽ FD
+    CLimitParam    m_limit;  // ׼ֵ
+    WorkerStats*   m_stats = nullptr; // б̵״̬̾ݴ˷ӡжϽ
+    CPoolParam     m_poolparam; // ҵ̳߳ص߳
+    SSL_CTX*       m_tls = nullptr; // ǿʱ TCP  TLS ֣׽Ϊ
+};
+
+enum ServerMode {
+    SERVER_HANDOFF = 0,  //  acceptͨ CProcess  FD ƽӽ
+    SERVER_REUSEPORT = 1 // ӽ̸԰ SO_REUSEPORT ׽ֱ acceptں˷ַ
+};
+
+//˲װ
+class CServerParam {
+public:
+    CServerParam(const Buffer& ip = "0.0.0.0", short port = 9999, int mode = SERVER_HANDOFF, unsigned workers = 1)
+        : ip(ip), port(port), mode(mode), workers(workers), batch(SOCKET_BATCH_MAX),
+        backlog(SOMAXCONN), drain(true), grace(10000), standby(0), hang(0), pathmode(0666), reservecpus(0) {}
+
+public:
+    Buffer   ip;      // ַ
+    short    port;    // ˿ڣ<=0 ʱ TCPֻ paths
+    int      mode;    // ServerMode
+    unsigned workers; // ҵӽprefork
+    unsigned batch;   // һλ accept ϲƽ1~SOCKET_BATCH_MAX
+    int      backlog; // listen гȣͻʱⶪ SYN
+    bool     drain;   // trueÿ̶߳ռ epoll׽ EPOLLEXCLUSIVE עᣬһλ accept4  EAGAIN
+    unsigned grace;   // ˳ʱӽ̴;ʱ䣨룩ʱǿƽ
+    unsigned standby; // Ԥ fork ݿıӽҵӽ̱ʱֱӶ棨 SERVER_HANDOFF
+    unsigned hang;    // ӽֹͣʱ룩Ϊٷ䲢ǿƽɼ0 ʾ
+    std::vector<Buffer> paths; // ı׽·ͬ룬ͬƽӽ
+    unsigned pathmode; // ׽ļȨޣͨû
+    unsigned reservecpus; // >0 ʱ CCpuPolicy  CPṴ߳ǰ reservecpus ˣҵ߳ϣ0 
+    CSockOption option; // ׽ֵ TCP ѡaccept Ӽ̳
+    CLimitParam limit;  // ׼ƣconnhard ɸִУҵӽִ
+    CTlsParam tls;      // tls.cert ǿʱҵӽ TCP ս TLS epoll ˣ
+};
+
+//¼ӽ̵ʱ˳Ĵ
+struct RespawnState {
+    std::chrono::steady_clock::time_point started; // һ fork ʱ
+    std::chrono::steady_clock::time_point respawn; // ˳ʱʱ
+    unsigned failures = 0; // ܿ˳Ĵ
+};
+
+//̲ҵӽ̼¼
+//λ Init ֮ӽý̶涼ԭλϽУ߳̿Բ
+struct WorkerSlot {
+    CProcess          process;  // IPC ͨ fork  FD ƽ
+    WorkerStats*      stats = nullptr; // е״̬ͱ־
+    std::atomic<bool> down{ false }; // ͨѶϿӽ˳
+    std::atomic<bool> exited{ false }; // ѱ waitpid գȴ
+    std::atomic<bool> standby{ false }; // ỵ́ɳʼ
+    std::mutex        mutex;    // лƽضȡ滻ͨ
+    RespawnState      state;
+};
+
+// CServer ܵӽ̣־̣˳ԭ
+struct SupervisedProcess {
+    CProcess*    process;
+    bool         exited = false;
+    RespawnState state;
 };
 
 
@@ -57,10 +156,23 @@ protected:
  * [ܹģ]: ߳ Epoll  +  FD ͸ģ͡
  * []:
  * 1. ̳ʼ̳߳ Epoll Server Socket
- * 2.  Fork ӽ̣ӽ̽ CBusiness::BusinessProcess 
+ * 2.  Fork  N ӽ̣ӽ̽ CBusiness::BusinessProcess 
  * 3. ͻ˷ TCP ̵֣ Epoll ִ Accept (Link)
- * 4. ͨ CProcess  Socket ļ (FD) ̷ӽ̡
+ * 4. ֱӶиӽ̵ѡߣͨ CProcess  Socket ļ (FD) ̷
  * 5.  Socket 󣨵صײFDӽ̽ӹӵݶд
+ * [SO_REUSEPORT ģʽ]: ̲ TCPӽ̸԰ͬһ˿ڲֱ Acceptʡȥÿһ sendmsg/recvmsg
+ * [׽]: paths еÿ·̼ TCP һ FD ƽӽ̣SO_REUSEPORT ģʽҲǣ
+ *             ӽ̰ SO_PEERCRED ¼Զ˽̶ IP ַ
+ * [˳]: Run  signalfd ϣյ SIGTERM/SIGINT/SIGHUP ֹͣ accept CProcess ֪ͨͨӽ
+ *              grace ſ; waitpid գʱδ˳ǿƽ
+ * [̼]: SIGCHLD ͬһ signalfd  Run˳ӽ̲ԭλ
+ *             ʱн̣߳ӽ Init У߳ʱfork  zygote Ϊ fork
+ *             ˱ýʱ棬ĽתΪµıáƽһӷʧʱһӽԡ
+ *             ܿ˳ӽָ̰˱ӳ
+ * []: fork ǰĹڴÿӽһж״̬ۣӽ̸¼
+ *           ̷ӡжϱ뿨ֻڴ棻socketpair ֻڱ״̬仯ʱѸ̡
+ * [׼]: ӽ̶ﵽӲʱѼ׽ִ epoll ժͣ acceptں˶
+ *             ӽ̻ٹһأӽԼֱӻ 503
  */
 class CServer
 {
@@ -73,17 +185,61 @@ public:
 public:
     //ʼ˻
     int Init(CBusiness* business, const Buffer& ip = "0.0.0.0", short port = 9999);
-    //̣߳άַ
+    int Init(CBusiness* business, const CServerParam& param);
+    //ֱ߳յ˳źţŹر
     int Run();
-    //ͷ Socket Epollӽ̷˳źţȫر̳߳
+    //ֹͣ accept ر̳߳أ֪ͨӽſպգͷ Socket  Epoll
     int Close();
+    //˳źţSIGTERM/SIGINT/SIGHUP/SIGCHLD Run е signalfd ͳһ
+    //źᱻӽ̺̼̳߳У fork ӽ̣־̣򴴽֮߳ǰ
+    static int BlockSignals(sigset_t* set = nullptr);
+    // proc  Run ܣ˳Զproc  CreateSubProcessڳ Run
+    int Supervise(CProcess* proc);
 private:
     //̳߳ع̵߳
     int ThreadFunc();
+    //ӽڣر̵ֵܽͨҵѭ
+    int WorkerProcess(size_t index);
+    //zygote fork ӽڣӹͨͬ WorkerProcess
+    int RespawnedWorker(uint32_t index, int channel);
+    // server  accept һӲƽӽ
+    int HandoffClients(CSocketBase* server);
+    //epoll data ָļ׽֣Ǽ׽ʱ nullptr
+    CSocketBase* FindServer(void* ptr);
+    //ӽ̱״̬仯֪ͨ
+    void UpdateWorker(const epoll_event& event);
+    //ѡ͵ӽ
+    WorkerSlot* PickWorker();
+    //˳ӽ̣еҵӽҵӽ˳ʱɱý̶
+    size_t ReapWorkers();
+    //ڵ˳ӽ̣ؾһĺ-1 ʾûд
+    int RespawnWorkers();
+    // zygote ԭλҵӽ̣ͨǼǵ m_epoll
+    int SpawnWorker(WorkerSlot* worker, size_t index);
+    //Ѳ죺ֹͣӽǿƽͽ֪ͨʧʱָ acceptؾһѲĺ-1 ʾҪ
+    int CheckWorkers();
+    //ֹͣ hang 
+    bool Hung(const WorkerSlot* worker, uint64_t now) const;
+    //ȴӽȫ˳ timeout 룬֮ǿƽʣ
+    void WaitWorkers(unsigned timeout);
+    //͵ӽҲѴﵽӲ
+    bool Saturated();
+    //ͣ/ָ acceptн epoll ժ/һȫ׽
+    void PauseAccept(bool pause);
 private:
     CThreadPool   m_pool;   // ̳߳أ Epoll ¼
-    CSocketBase*  m_server = nullptr;// ˼׽ָ
+    std::vector<CSocketBase*> m_servers;// ̵ļ׽֣TCP ׽·
     CEpoll        m_epoll;  //  I/O ¼
-    CProcess      m_process;//IPC ͨŹ Fork  FD 
+    std::vector<WorkerSlot*> m_workers;//ҵӽ̣ Fork  FD 
+    CControlPlane m_control; // ӽ̹״̬ۣfork ֮ǰ
+    CTlsContext   m_tls;     // ֤ƱԿfork ֮ǰӽ̼̳
     CBusiness*    m_business = nullptr; // ҵģ,ֶ delete
+    CServerParam  m_param;  // 
+    bool          m_running = false; // Run() б־
+    int           m_signal = -1; // signalfd˳ź SIGCHLD
+    std::mutex    m_acceptMutex;  // 
+    std::vector<CEpoll*> m_acceptors; // ż׽ֵ epolldrain ģʽΪ̵߳ľֲ epollΪ m_epoll
+    std::atomic<bool> m_paused{ false }; // ͣ accept
+    std::vector<SupervisedProcess> m_supervised; // ܼܵӽ
+    CForkServer   m_zygote; // ̵߳ fork ̣Init ֮߳ǰӽ̶ fork
 };
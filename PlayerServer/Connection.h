@@ -0,0 +1,117 @@
+#pragma once
+#include <sys/resource.h>
+#include <atomic>
+#include <vector>
+#include "Public.h"
+#include "Socket.h"
+#include "Timer.h"
+
+#define CONNECTION_SLOTS_MAX 65536 //连接槽上限，实际取 min(RLIMIT_NOFILE, 上限)
+#define CONNECTION_LISTENER (~0ull) //epoll data 中代表监听套接字的键
+#define CONNECTION_TIMER (~1ull)    //epoll data 中代表时间轮 timerfd 的键
+#define CONNECTION_GEN_MASK 0xFFFFFF //代数只用 24 位，键的高 8 位留给 io_uring 的操作类型
+
+//连接状态：套接字与读缓冲
+//对象常驻于 CConnectionSlab，连接关闭后槽位连同读缓冲的内存一起复用
+class CConnection {
+public:
+    CConnection() : sock(nullptr), offset(0), deadline(false), shed(false), recving(false), closing(false), gen(0), used(false) { timer.data = this; }
+    ~CConnection() { delete sock; }
+    CConnection(const CConnection&) = delete;
+    CConnection& operator=(const CConnection&) = delete;
+
+    int Fd() const { return sock ? (int)(*sock) : -1; }
+    //epoll data / io_uring user_data 中保存的键：[55:32] 代数，[31:0] fd
+    uint64_t Key() const { return ((uint64_t)gen << 32) | (uint32_t)Fd(); }
+
+public:
+    CSocketBase* sock;
+    Buffer input;   //已读入、尚未交给业务的数据
+    size_t offset;  //input 中已处理完的前缀长度
+    CTimerNode timer; //超时定时器，挂在所属循环的时间轮上
+    bool deadline;    //当前定时器是否为读请求截止时间（收到字节不顺延）
+    bool shed;        //已回 503（Connection: close）：不再处理后续请求，响应写完即断开
+    bool recving;     //io_uring 模式：多发 recv 仍在内核中
+    bool closing;     //io_uring 模式：已 shutdown，等在途操作全部返回后释放
+    uint32_t gen;   //代数，槽位每被占用一次加一，用来识别过期的 epoll 事件
+    std::atomic<bool> used; //槽位是否被占用
+};
+
+//以 fd 为下标的连接槽数组
+//查找 O(1)；Init 时一次性分配，运行期不再随连接 malloc
+//同一个 fd 同时只会属于一个连接：占用在 accept/接收之后，释放在 close 之前
+class CConnectionSlab {
+public:
+    CConnectionSlab() {}
+    ~CConnectionSlab() {}
+    CConnectionSlab(const CConnectionSlab&) = delete;
+    CConnectionSlab& operator=(const CConnectionSlab&) = delete;
+
+public:
+    //capacity 为 0 时按 RLIMIT_NOFILE 决定槽位数
+    int Init(size_t capacity = 0) {
+        if (!m_slots.empty()) return -1;
+        if (capacity == 0) {
+            rlimit limit;
+            if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return -2;
+            capacity = (limit.rlim_cur == RLIM_INFINITY) ? CONNECTION_SLOTS_MAX : (size_t)limit.rlim_cur;
+            if (capacity > CONNECTION_SLOTS_MAX) capacity = CONNECTION_SLOTS_MAX;
+        }
+        std::vector<CConnection> slots(capacity);
+        m_slots.swap(slots);
+        return 0;
+    }
+
+    //为新连接占用 fd 对应的槽位；fd 超出容量或槽位未释放时返回 nullptr，调用方负责关闭 sock
+    CConnection* Acquire(CSocketBase* sock) {
+        int fd = (int)(*sock);
+        if (fd < 0 || (size_t)fd >= m_slots.size()) return nullptr;
+        CConnection& conn = m_slots[fd];
+        if (conn.used.load(std::memory_order_acquire)) return nullptr;
+        conn.sock = sock;
+        conn.input.clear();
+        conn.offset = 0;
+        conn.deadline = false;
+        conn.shed = false;
+        conn.recving = false;
+        conn.closing = false;
+        conn.gen = (conn.gen + 1) & CONNECTION_GEN_MASK;
+        conn.used.store(true, std::memory_order_release);
+        return &conn;
+    }
+
+    //按 epoll data 中的键查找；槽位已释放或已被新连接占用（代数不同）时返回 nullptr
+    CConnection* Find(uint64_t key) {
+        uint32_t fd = (uint32_t)key;
+        if (fd >= m_slots.size()) return nullptr;
+        CConnection& conn = m_slots[fd];
+        if (!conn.used.load(std::memory_order_acquire)) return nullptr;
+        if (conn.gen != (uint32_t)(key >> 32)) return nullptr;
+        return &conn;
+    }
+
+    //释放槽位并关闭连接；先标记空闲再关闭 fd，保证 fd 被内核复用时槽位已可用
+    //调用前须先把 conn->timer 从时间轮上取消
+    void Release(CConnection* conn) {
+        if (!conn || !conn->used.load(std::memory_order_acquire)) return;
+        CSocketBase* sock = conn->sock;
+        conn->sock = nullptr;
+        conn->input.clear();
+        conn->offset = 0;
+        conn->used.store(false, std::memory_order_release);
+        delete sock;
+    }
+
+    //遍历在用的连接
+    template <typename _FUNCTION_>
+    void ForEach(_FUNCTION_ func) {
+        for (CConnection& conn : m_slots) {
+            if (conn.used.load(std::memory_order_acquire)) func(&conn);
+        }
+    }
+
+    size_t Capacity() const { return m_slots.size(); }
+
+private:
+    std::vector<CConnection> m_slots;
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <sys/mman.h>
+#include <time.h>
+#include <stdint.h>
+#include <atomic>
+
+#define CONTROL_CACHELINE 64 //每个子进程的状态独占缓存行，各自写入时不互相失效
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+    "control plane needs lock-free atomics to share them across processes");
+
+//单个业务子进程的运行状态，位于 fork 之前创建的共享内存中
+//子进程写、父进程读，全部是无锁原子量，父进程读取不需要系统调用或消息往返
+struct alignas(CONTROL_CACHELINE) WorkerStats {
+    std::atomic<int>      connections; //在线连接数；父进程移交后先乐观加上，子进程随后写入实际值
+    std::atomic<int>      inflight;    //正在业务中处理的请求数
+    std::atomic<int>      queue;       //排队等待数据库的请求数
+    std::atomic<int>      saturated;   //非 0：已达到硬上限，父进程不再移交
+    std::atomic<uint64_t> requests;    //累计处理的请求数
+    std::atomic<uint64_t> heartbeat;   //最近一次心跳（CLOCK_MONOTONIC 毫秒），由事件循环的时间轮刻度刷新
+    std::atomic<uint64_t> spinning;    //忙轮询模式下空转等待事件的累计时间（微秒）
+    std::atomic<uint64_t> working;     //忙轮询模式下处理事件的累计时间（微秒），与 spinning 对比即空转占比
+
+    //fork 之前由父进程调用：心跳从当前时刻算起，子进程初始化期间不会被当作卡死
+    void Reset(uint64_t now) {
+        connections.store(0, std::memory_order_relaxed);
+        inflight.store(0, std::memory_order_relaxed);
+        queue.store(0, std::memory_order_relaxed);
+        saturated.store(0, std::memory_order_relaxed);
+        requests.store(0, std::memory_order_relaxed);
+        heartbeat.store(now, std::memory_order_relaxed);
+        spinning.store(0, std::memory_order_relaxed);
+        working.store(0, std::memory_order_relaxed);
+    }
+};
+
+//父子进程共享的控制面：MAP_SHARED 匿名映射，父进程在 fork 之前 Init，子进程继承同一块物理内存
+class CControlPlane {
+public:
+    CControlPlane() : m_stats(nullptr), m_count(0) {}
+    ~CControlPlane() { Close(); }
+    CControlPlane(const CControlPlane&) = delete;
+    CControlPlane& operator=(const CControlPlane&) = delete;
+
+public:
+    int Init(size_t count) {
+        if (m_stats != nullptr) return -1;
+        if (count == 0) return -2;
+        void* addr = mmap(nullptr, sizeof(WorkerStats) * count, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) return -3;
+        m_stats = (WorkerStats*)addr;//匿名映射已清零，全零即原子量的初始状态
+        m_count = count;
+        uint64_t now = Now();
+        for (size_t i = 0; i < m_count; i++) m_stats[i].Reset(now);
+        return 0;
+    }
+
+    WorkerStats* Stats(size_t index) const { return (index < m_count) ? &m_stats[index] : nullptr; }
+    size_t Size() const { return m_count; }
+
+    void Close() {
+        if (m_stats) {
+            munmap(m_stats, sizeof(WorkerStats) * m_count);
+            m_stats = nullptr;
+            m_count = 0;
+        }
+    }
+
+    //单调时钟毫秒数，走 vDSO，不进内核
+    static uint64_t Now() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+    }
+
+private:
+    WorkerStats* m_stats;
+    size_t m_count;
+};
@@ -5,8 +5,12 @@
 #include <signal.h>
 #include <memory.h>
 #include <errno.h>
+#include <stdint.h>
+#include <atomic>
+#include <sys/eventfd.h>
 
 #define EVENT_SIZE 128
+#define EPOLL_WAKE_KEY (~2ull) // eventfd  epoll data еļWaitEvents ڲ᷵ظ÷
 
 //װepoll_data_t
 /*
@@ -86,8 +90,11 @@ using EPEvents = std::vector<epoll_event>;
 
 class CEpoll {
 public:
-    CEpoll() : m_epoll(-1) {}
-    ~CEpoll() { Close(); }
+    CEpoll() : m_epoll(-1), m_wake(-1), m_stop(false) {}
+    ~CEpoll() {
+        Close();
+        if (m_wake != -1) ::close(m_wake);
+    }
 
     CEpoll(const CEpoll&) = delete;
     CEpoll& operator=(const CEpoll&) = delete;
@@ -99,29 +106,63 @@ public:
         if (m_epoll != -1) return -1;
         m_epoll = epoll_create(static_cast<int>(count));
         if (m_epoll == -1) return -2;
+        //ͨWake/Close д eventfd WaitEvents ֮߳أȴ˿Բ賬ʱ
+        if (m_wake == -1) {
+            m_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (m_wake == -1) { Close(); return -3; }
+        }
+        else {
+            uint64_t value = 0;
+            read(m_wake, &value, sizeof(value));
+        }
+        m_stop = false;
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u64 = EPOLL_WAKE_KEY;
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &ev) == -1) { Close(); return -4; }
         return 0;
     }
 
-    // ֵ<0 =0 û¼>0 ¼
-    ssize_t WaitEvents(EPEvents& events, int timeout = 10) {
-        if (m_epoll == -1) return -1;
+    // ֵ<0  Close=0 û¼ʱ/ź/Wake>0 ¼
+    // ֱӰ events  epoll_wait״ε EVENT_SIZE ֮ٷ䣻÷Ӧѭⶨ events
+    // timeout Ĭ -1 һֱ Wake/Close 
+    ssize_t WaitEvents(EPEvents& events, int timeout = -1) {
+        if (m_epoll == -1 || m_stop) return -1;
+        if (events.size() < EVENT_SIZE) events.resize(EVENT_SIZE);
 
-        EPEvents tmp(EVENT_SIZE);
-        int ret = epoll_wait(m_epoll, tmp.data(), static_cast<int>(tmp.size()), timeout);
+        int ret = epoll_wait(m_epoll, events.data(), static_cast<int>(events.size()), timeout);
         if (ret == -1) {
             if (errno == EINTR || errno == EAGAIN) {
                 return 0;
             }
             return -2;
         }
-
-        if (ret > static_cast<int>(events.size())) {
-            events.resize(ret);
+        if (m_stop) return -1;
+
+        ssize_t count = 0;
+        for (int i = 0; i < ret; i++) {
+            if (events[i].data.u64 == EPOLL_WAKE_KEY) {//ͨѣռظ÷
+                uint64_t value = 0;
+                read(m_wake, &value, sizeof(value));
+                continue;
+            }
+            if (count != i) events[count] = events[i];
+            count++;
         }
-        memcpy(events.data(), tmp.data(), sizeof(epoll_event) * ret);
-        return ret;
+        return count;
     }
 
+    //  WaitEvents е߳
+    int Wake() {
+        if (m_wake == -1) return -1;
+        uint64_t one = 1;
+        if (write(m_wake, &one, sizeof(one)) != sizeof(one)) return -2;
+        return 0;
+    }
+
+    // õ eventfdǶ׵ epoll ʱͬʱԱ Close ʱһ
+    int WakeFd() const { return m_wake; }
+
     int Add(int fd, const EpollData& data = EpollData((void*)0), uint32_t events = EPOLLIN) {
         if (m_epoll == -1) return -1;
         epoll_event ev;
@@ -149,8 +190,12 @@ public:
         return 0;
     }
 
+    // ֹͣñ־д eventfdֹͣٶգеȴ̶߳ᱻѲ -1ٹر epoll
+    // eventfd ʱرգ֤߳Ҳܿ
     void Close() {
         if (m_epoll != -1) {
+            m_stop = true;
+            Wake();
             int fd = m_epoll;
             m_epoll = -1;
             ::close(fd);
@@ -158,4 +203,6 @@ public:
     }
 private:
     int m_epoll;//fd
+    int m_wake; //eventfd
+    std::atomic<bool> m_stop;
 };
\ No newline at end of file
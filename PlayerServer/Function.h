@@ -2,73 +2,202 @@
 
 #include <unistd.h>
 #include <sys/types.h>
-#include <functional>
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
 class CSocketBase;
 class Buffer;
 
-class CFunctionBase
-{
-public:
-    virtual ~CFunctionBase() {}
+#define FUNCTION_INLINE_SIZE 48 //洢ֽԱָ + this + ָСĲŵ£ָͬһ
 
-    virtual int operator()() { return 0; }
-    virtual int operator()(CSocketBase*) { return 0; }
-    virtual int operator()(CSocketBase*, const Buffer&) { return 0; }
-};
+// ±УC++11 û std::index_sequence
+template <size_t... _I_> struct CIndexes {};
+template <size_t _N_, size_t... _I_> struct CMakeIndexes : CMakeIndexes<_N_ - 1, _N_ - 1, _I_...> {};
+template <size_t... _I_> struct CMakeIndexes<0, _I_...> { typedef CIndexes<_I_...> type; };
 
+// 󶨵ĺǰòʱٰѵòں棨 std::bindҲûռλ
 template <typename _FUNCTION_, typename... _ARGS_>
-class CFunction : public CFunctionBase
+class CBinder
 {
 public:
-    //  std::forward ת洢 std::bind 
-    CFunction(_FUNCTION_ func, _ARGS_... args)
-        : m_binder(std::bind(std::move(func), std::move(args)...))
-    {}
+    template <typename _F_, typename... _A_>
+    explicit CBinder(_F_&& func, _A_&&... args)
+        : m_func(std::forward<_F_>(func)), m_args(std::forward<_A_>(args)...) {}
 
-    int operator()() override
+    template <typename _RET_, typename... _PARAMS_>
+    _RET_ Call(_PARAMS_&&... params)
     {
-        return m_binder();
+        return Apply<_RET_>(typename CMakeIndexes<sizeof...(_ARGS_)>::type(), std::forward<_PARAMS_>(params)...);
     }
 
 private:
-    // ʹ std::function 洢󶨺Ŀִ
-    std::function<int()> m_binder;
-};
+    template <typename _RET_, size_t... _I_, typename... _PARAMS_>
+    _RET_ Apply(CIndexes<_I_...>, _PARAMS_&&... params)
+    {
+        return Invoke(std::is_member_function_pointer<_FUNCTION_>(), m_func,
+            std::get<_I_>(m_args)..., std::forward<_PARAMS_>(params)...);
+    }
 
-template <typename _FUNCTION_, typename... _ARGS_>
-class CConnectedFunction : public CFunctionBase
-{
-public:
-    CConnectedFunction(_FUNCTION_ func, _ARGS_... args)
-        : m_binder(std::bind(std::move(func), std::move(args)...))
+    // Աָ룺һǶָ룬ֱ (obj->*func)(...)
+    template <typename _F_, typename _OBJ_, typename... _PARAMS_>
+    static auto Invoke(std::true_type, _F_& func, _OBJ_&& obj, _PARAMS_&&... params)
+        -> decltype((obj->*func)(std::forward<_PARAMS_>(params)...))
     {
+        return (obj->*func)(std::forward<_PARAMS_>(params)...);
     }
 
-    int operator()(CSocketBase* pClient) override
+    // ͨ
+    template <typename _F_, typename... _PARAMS_>
+    static auto Invoke(std::false_type, _F_& func, _PARAMS_&&... params)
+        -> decltype(func(std::forward<_PARAMS_>(params)...))
     {
-        return m_binder(pClient);
+        return func(std::forward<_PARAMS_>(params)...);
     }
 
 private:
-    std::function<int(CSocketBase*)> m_binder;
+    _FUNCTION_ m_func;
+    std::tuple<_ARGS_...> m_args;
 };
 
-template <typename _FUNCTION_, typename... _ARGS_>
-class CRecvFunction : public CFunctionBase
+/*
+* ֻƶĻصCFunction<int(...)>(, ǰò...)
+* 󶨶󲻳 FUNCTION_INLINE_SIZE ʱֱӷڲڴ棻Ĳ new
+* һָͨתû麯Ҳû std::function ĵڶ
+*/
+template <typename _SIGNATURE_> class CFunction;
+
+template <typename _RET_, typename... _PARAMS_>
+class CFunction<_RET_(_PARAMS_...)>
 {
 public:
-    CRecvFunction(_FUNCTION_ func, _ARGS_... args)
-        : m_binder(std::bind(std::move(func), std::move(args)...))
+    CFunction() : m_invoke(nullptr), m_manage(nullptr) {}
+    CFunction(std::nullptr_t) : m_invoke(nullptr), m_manage(nullptr) {}
+
+    template <typename _FUNCTION_, typename... _ARGS_, typename = typename std::enable_if<
+        !std::is_same<typename std::decay<_FUNCTION_>::type, CFunction>::value>::type>
+    CFunction(_FUNCTION_&& func, _ARGS_&&... args)
+        : m_invoke(nullptr), m_manage(nullptr)
+    {
+        typedef CBinder<typename std::decay<_FUNCTION_>::type, typename std::decay<_ARGS_>::type...> Binder;
+        Store<Binder>(std::integral_constant<bool, Fits<Binder>::value>(),
+            std::forward<_FUNCTION_>(func), std::forward<_ARGS_>(args)...);
+    }
+
+    CFunction(CFunction&& other) : m_invoke(nullptr), m_manage(nullptr) { MoveFrom(other); }
+
+    CFunction& operator=(CFunction&& other)
+    {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    CFunction& operator=(std::nullptr_t)
+    {
+        Reset();
+        return *this;
+    }
+
+    ~CFunction() { Reset(); }
+
+    CFunction(const CFunction&) = delete;
+    CFunction& operator=(const CFunction&) = delete;
+
+public:
+    _RET_ operator()(_PARAMS_... params)
     {
+        return m_invoke(m_buffer, std::forward<_PARAMS_>(params)...);
     }
 
-    int operator()(CSocketBase* pClient, const Buffer& data) override
+    explicit operator bool() const { return m_invoke != nullptr; }
+
+    // 󶨵ĶͲ֮¸ֵ
+    void Reset()
     {
-        return m_binder(pClient, data);
+        if (m_manage) m_manage(OP_DESTROY, m_buffer, nullptr);
+        m_invoke = nullptr;
+        m_manage = nullptr;
     }
 
 private:
-    std::function<int(CSocketBase*, const Buffer&)> m_binder;
+    enum { OP_DESTROY = 0, OP_MOVE = 1 };
+    typedef _RET_(*Invoker)(void*, _PARAMS_&&...);
+    typedef void(*Manager)(int, void*, void*);
+
+    template <typename _BINDER_>
+    struct Fits : std::integral_constant<bool,
+        sizeof(_BINDER_) <= FUNCTION_INLINE_SIZE &&
+        alignof(std::max_align_t) % alignof(_BINDER_) == 0 &&
+        std::is_nothrow_move_constructible<_BINDER_>::value> {};
+
+    // 洢 m_buffer 
+    template <typename _BINDER_, typename... _ARGS_>
+    void Store(std::true_type, _ARGS_&&... args)
+    {
+        new (m_buffer) _BINDER_(std::forward<_ARGS_>(args)...);
+        m_invoke = &InlineInvoke<_BINDER_>;
+        m_manage = &InlineManage<_BINDER_>;
+    }
+
+    // Ų£m_buffer ֻѶָ
+    template <typename _BINDER_, typename... _ARGS_>
+    void Store(std::false_type, _ARGS_&&... args)
+    {
+        *reinterpret_cast<_BINDER_**>(m_buffer) = new _BINDER_(std::forward<_ARGS_>(args)...);
+        m_invoke = &HeapInvoke<_BINDER_>;
+        m_manage = &HeapManage<_BINDER_>;
+    }
+
+    template <typename _BINDER_>
+    static _RET_ InlineInvoke(void* buffer, _PARAMS_&&... params)
+    {
+        return static_cast<_BINDER_*>(buffer)->template Call<_RET_>(std::forward<_PARAMS_>(params)...);
+    }
+
+    template <typename _BINDER_>
+    static void InlineManage(int op, void* dst, void* src)
+    {
+        if (op == OP_MOVE) {
+            new (dst) _BINDER_(std::move(*static_cast<_BINDER_*>(src)));
+            static_cast<_BINDER_*>(src)->~_BINDER_();
+        }
+        else static_cast<_BINDER_*>(dst)->~_BINDER_();
+    }
+
+    template <typename _BINDER_>
+    static _RET_ HeapInvoke(void* buffer, _PARAMS_&&... params)
+    {
+        return (*static_cast<_BINDER_**>(buffer))->template Call<_RET_>(std::forward<_PARAMS_>(params)...);
+    }
+
+    template <typename _BINDER_>
+    static void HeapManage(int op, void* dst, void* src)
+    {
+        if (op == OP_MOVE) *static_cast<_BINDER_**>(dst) = *static_cast<_BINDER_**>(src);
+        else delete *static_cast<_BINDER_**>(dst);
+    }
+
+    void MoveFrom(CFunction& other)
+    {
+        if (other.m_manage == nullptr) return;
+        other.m_manage(OP_MOVE, m_buffer, other.m_buffer);
+        m_invoke = other.m_invoke;
+        m_manage = other.m_manage;
+        other.m_invoke = nullptr;
+        other.m_manage = nullptr;
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char m_buffer[FUNCTION_INLINE_SIZE];
+    Invoker m_invoke;
+    Manager m_manage;
 };
+
+typedef CFunction<int()> CTaskFunction;                                     // ̡̳߳߳
+typedef CFunction<int(CSocketBase*)> CConnectedFunction;                    // ӽص
+typedef CFunction<int(CSocketBase*, const Buffer&)> CRecvFunction;          // յص
@@ -70,6 +70,30 @@ size_t CHttpParser::Parser(const Buffer& data)
     return ret;
 }
 
+//  message_complete ͣhttp_parser_execute صĳ
+static int OnFrameComplete(http_parser* parser)
+{
+    *static_cast<bool*>(parser->data) = true;
+    http_parser_pause(parser, 1);
+    return 0;
+}
+
+ssize_t CHttpParser::Frame(const char* data, size_t size)
+{
+    http_parser parser;
+    http_parser_settings settings;
+    bool complete = false;
+    memset(&settings, 0, sizeof(settings));
+    settings.on_message_complete = &OnFrameComplete;
+    http_parser_init(&parser, HTTP_REQUEST);
+    parser.data = &complete;
+
+    size_t ret = http_parser_execute(&parser, &settings, data, size);
+    if (complete) return (ssize_t)ret;
+    if (parser.http_errno != HPE_OK) return -1;
+    return 0;
+}
+
 // ---------- static callbacks ----------
 
 int CHttpParser::OnMessageBegin(http_parser* parser)
@@ -3,6 +3,7 @@
 #include "Public.h"
 #include "http_parser.h"
 #include <map>
+#include <sys/types.h>
 
 // ԭʼֽн Method / Url / Headers / Body Ϣ
 class CHttpParser
@@ -28,6 +29,10 @@ public:
     const Buffer& Body() const { return m_body; }
     unsigned Errno() const { return m_parser.http_errno; } //
 
+    // ķ֡ж data ͷǷһ
+    // ֵ>0 ֽ0 ݲ<0 ʽ
+    static ssize_t Frame(const char* data, size_t size);
+
 protected:
     // http-parser ̬ص parser->data תضʵתԱ
     static int OnMessageBegin(http_parser* parser);
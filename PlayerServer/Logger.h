@@ -92,8 +92,8 @@ public:
     CLoggerServer(const CLoggerServer&) = delete;
     CLoggerServer& operator=(const CLoggerServer&) = delete;
 public:
-    // ־Ŀ¼/ļ/epoll/socket/̣߳
-    int Start() {
+    // ־Ŀ¼/ļ/epoll/socket/̣߳param Ϊ־̵߳ CPU 
+    int Start(const CThreadParam& param = CThreadParam()) {
         if (m_server != nullptr) // ֹظ
             return -1;
 
@@ -132,6 +132,9 @@ public:
         }
 
         // ־̣߳ ThreadFunc epoll ѭ
+        CThreadParam attr = param;
+        if (attr.name.size() == 0) attr.name = "ps-log";
+        m_thread.SetParam(attr);
         if (m_thread.Start() != 0) {
             Close();
             return -7;
@@ -147,8 +150,8 @@ public:
         // ѭ߳Ч + epoll  + server 
         while (m_thread.isValid() && m_server) {
 
-            // ȴ¼timeout=1
-            ssize_t ret = m_epoll.WaitEvents(events, 1);
+            // ȴ¼Close ʱ epoll Ļͨ
+            ssize_t ret = m_epoll.WaitEvents(events);
             if (ret < 0)
                 break;
 
@@ -213,6 +216,9 @@ public:
     }
     // ͷ serverر epollֹͣ߳
     int Close() {
+        //ȻѲͣ־̣߳ͷõ server ļ
+        m_epoll.Close();
+        m_thread.Stop();
         if (m_server) {
             delete m_server;
             m_server = nullptr;
@@ -221,8 +227,6 @@ public:
             fclose(m_file);
             m_file = nullptr;
         }
-        m_epoll.Close();
-        m_thread.Stop();
         return 0;
     }
 public:
@@ -245,8 +249,8 @@ public:
             }
         }
 
-        // ־ݵ־
-        client.Send(info);
+        // ־ݵ־ʧ˵־˳صӣһ־־
+        if (client.Send(info) < 0) client.Close();
     }
     // ȡǰʱַ־ļ/־ͷ
     static Buffer GetTimeStr() {
@@ -6,52 +6,196 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <cstdlib>
+#include <netinet/in.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#define SOCKET_BATCH_MAX 32 //  sendmsg ƽ FD 
+#define PROCESS_CMD_DRAIN 0xFFFFFFFFu // ͨϵſռƽֶΣ 4 ֽޣ룩
+
+/*
+* fork ̣zygoteڸ̻ǵ߳ʱ fork ֮ӽ̶Ϊ fork
+* ߳̽ fork ӽֻʣ̵̣߳߳ʱеԶͷţzygote ʼյ̣߳û
+* ½̾һм zygote̸Ϊ subreaper ĸ̣ճ waitpid 
+*  entry(index, channel) ½Уindex ָchannel 󷽽ͨ
+*/
+class CForkServer {
+public:
+    CForkServer() : m_channel(-1), m_pid(-1) {}
+    ~CForkServer() { Close(); }
+    CForkServer(const CForkServer&) = delete;
+    CForkServer& operator=(const CForkServer&) = delete;
+
+    // ڴκ֮߳ǰãڵİ󶨲 fork Ƶ zygote
+    template <typename _FUNCTION_, typename... _ARGS_>
+    int Start(_FUNCTION_&& func, _ARGS_&&... args) {
+        if (m_channel != -1) return -1;
+        if (prctl(PR_SET_CHILD_SUBREAPER, 1) != 0) return -2;
+        m_entry = CFunction<int(uint32_t, int)>(std::forward<_FUNCTION_>(func), std::forward<_ARGS_>(args)...);
+        int pair[2];
+        if (socketpair(AF_LOCAL, SOCK_SEQPACKET, 0, pair) == -1) return -3;
+        pid_t parent = getpid();
+        pid_t pid = fork();
+        if (pid == -1) {
+            close(pair[0]);
+            close(pair[1]);
+            return -4;
+        }
+        if (pid == 0) {
+            close(pair[0]);
+            // 쳣˳ʱһfork ֮prctl ֮ǰ̾˳ getppid 
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != parent) _exit(0);
+            _exit(Serve(pair[1]));
+        }
+        close(pair[1]);
+        m_channel = pair[0];
+        m_pid = pid;
+        return 0;
+    }
+
+    // ̣ fork һ½̣channel 󽻸˵ĸɵ÷رգ
+    // ½ pidʧܷ -1ͬһʱֻһ̵߳
+    pid_t Spawn(uint32_t index, int channel) {
+        if (m_channel == -1) return -1;
+        msghdr msg;
+        bzero(&msg, sizeof(msg));
+        iovec iov;
+        iov.iov_base = &index;
+        iov.iov_len = sizeof(index);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        char control[CMSG_SPACE(sizeof(int))];
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        memcpy(CMSG_DATA(cmsg), &channel, sizeof(int));
+        ssize_t ret;
+        do {
+            ret = sendmsg(m_channel, &msg, MSG_NOSIGNAL);
+        } while (ret == -1 && errno == EINTR);
+        if (ret != sizeof(index)) return -1;
+        pid_t pid = -1;
+        do {
+            ret = recv(m_channel, &pid, sizeof(pid), 0);
+        } while (ret == -1 && errno == EINTR);
+        if (ret != sizeof(pid)) return -1;
+        return pid;
+    }
+
+    // ̣ zygote ˳գshutdown ׽ֱ̼̳еĸҲס EOF
+    void Close() {
+        if (m_channel == -1) return;
+        shutdown(m_channel, SHUT_RDWR);
+        Detach();
+        if (m_pid > 0) waitpid(m_pid, NULL, 0);
+        m_pid = -1;
+    }
+
+    // ֱ fork ӽֻ̣ص̳ͨ shutdown
+    void Detach() {
+        if (m_channel == -1) return;
+        close(m_channel);
+        m_channel = -1;
+    }
+
+private:
+    // zygote ѭÿ fork һм̣ fork ½̺˳
+    int Serve(int channel) {
+        while (true) {
+            uint32_t index = 0;
+            msghdr msg;
+            bzero(&msg, sizeof(msg));
+            iovec iov;
+            iov.iov_base = &index;
+            iov.iov_len = sizeof(index);
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            char control[CMSG_SPACE(sizeof(int))];
+            memset(control, 0, sizeof(control));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            ssize_t ret = recvmsg(channel, &msg, 0);
+            if (ret == -1 && errno == EINTR) continue;
+            if (ret <= 0) return 0; //ѹرͨ
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            int fd = -1;
+            if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+            }
+            pid_t pid = -1;
+            int link[2];
+            if ((fd != -1) && (ret == sizeof(index)) && (pipe2(link, O_CLOEXEC) == 0)) {
+                pid_t middle = fork();
+                if (middle == 0) {
+                    close(link[0]);
+                    pid_t child = fork();
+                    if (child == 0) {
+                        close(link[1]);
+                        close(channel);
+                        _exit(m_entry(index, fd));
+                    }
+                    write(link[1], &child, sizeof(child));
+                    _exit(0);
+                }
+                close(link[1]);
+                if (middle != -1) {
+                    if (read(link[0], &pid, sizeof(pid)) != sizeof(pid)) pid = -1;
+                    //м̻֮½̲ѹ̸̣ʱٻظ̵ waitpid ˿
+                    waitpid(middle, NULL, 0);
+                }
+                close(link[0]);
+            }
+            if (fd != -1) close(fd);
+            send(channel, &pid, sizeof(pid), MSG_NOSIGNAL);
+        }
+    }
+
+private:
+    CFunction<int(uint32_t, int)> m_entry;
+    int m_channel; //̣ zygote ͨ
+    pid_t m_pid;   //zygote  pid
+};
 
 class CProcess {
 public:
-    CProcess() : m_func(nullptr), m_pid(-1) {
+    CProcess() : m_pid(-1), m_drain(0), m_loadLength(0) {
         memset(pipes,-1, sizeof(pipes));
     }
 
-    // ֶڴ棺ʱͷԭʼָ
     ~CProcess() {
-        if (m_func) {
-            delete m_func;
-            m_func = nullptr;
-        }
         if (pipes[0] > 0) close(pipes[0]);
         if (pipes[1] > 0) close(pipes[1]);
     }
 
     template <typename _FUNCTION_, typename... _ARGS_>
     int SetEntryFunction(_FUNCTION_&& func, _ARGS_&&... args) {
-        // ε SetEntryFunctionɵ
-        if (m_func) {delete m_func;}
-
-        // 1. ʹ std::decay ͣȥú const η
-        // 2. ʹԭʼָ new 
-        typedef CFunction<
-            typename std::decay<_FUNCTION_>::type,
-            typename std::decay<_ARGS_>::type...> ConcreteFunction;
-
-        m_func = new ConcreteFunction(
-            std::forward<_FUNCTION_>(func),
-            std::forward<_ARGS_>(args)...);
+        // εʱɵ渳ֵֵstd::decay 󣩱 m_func ڲ
+        m_func = CTaskFunction(std::forward<_FUNCTION_>(func), std::forward<_ARGS_>(args)...);
         return 0;
     }
 
+    // ظãӽ˳ٴεüͬһ𣬾ͨȹر
     int CreateSubProcess() {
         if (!m_func) return -1;
+        ClosePipe();
         int ret = socketpair(AF_LOCAL, SOCK_STREAM, 0, pipes);
         if (ret == -1) return -2;
         pid_t pid = fork();
-        if (pid == -1) return -3;
+        if (pid == -1) {
+            ClosePipe();
+            return -3;
+        }
         if (pid == 0) {
             // ӽִҵ߼
             close(pipes[1]); // رд
             pipes[1] = -1;
             // ӽֻ pipes[0] Ը̵Ϣ
-            int ret = (*m_func)();
+            int ret = m_func();
             _exit(ret);
         }
         // 
@@ -62,6 +206,29 @@ public:
         return 0;
     }
 
+    //  fork ̴ӽ̴̣ʱǶ̣߳fork ɵ̵߳ zygote 
+    // ӽ̵ zygote  index  Attach ȥͨ
+    int CreateSubProcess(CForkServer& server, uint32_t index) {
+        ClosePipe();
+        int ret = socketpair(AF_LOCAL, SOCK_STREAM, 0, pipes);
+        if (ret == -1) return -2;
+        pid_t pid = server.Spawn(index, pipes[0]);
+        close(pipes[0]);
+        pipes[0] = -1;
+        if (pid <= 0) {
+            ClosePipe();
+            return -3;
+        }
+        m_pid = pid;
+        return 0;
+    }
+
+    //  zygote ӽ̣ӹܸ̽ͨ
+    void Attach(int channel) {
+        ClosePipe();
+        pipes[0] = channel;
+    }
+
     int SendFD(int fd) {
         struct msghdr msg;
         memset(&msg, 0, sizeof(msg)); // ʼϢṹ
@@ -201,6 +368,152 @@ public:
         return 0;
     }
 
+    // ƽһ sendmsg  count  FD Žͬһ SCM_RIGHTSַ˳ iovec 
+    int SendSockets(const int* fds, const sockaddr_in* addrins, size_t count) {
+        if (count == 0 || count > SOCKET_BATCH_MAX) return -1;
+        msghdr msg;
+        bzero(&msg, sizeof(msg));
+
+        //[][sockaddr_in * count]
+        uint32_t head = (uint32_t)count;
+        iovec iov[2];
+        iov[0].iov_base = &head;
+        iov[0].iov_len = sizeof(head);
+        iov[1].iov_base = (void*)addrins;
+        iov[1].iov_len = sizeof(sockaddr_in) * count;
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+
+        char control[CMSG_SPACE(sizeof(int) * SOCKET_BATCH_MAX)];
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+
+        ssize_t ret;
+        do {
+            ret = sendmsg(pipes[1], &msg, MSG_NOSIGNAL);
+        } while (ret == -1 && errno == EINTR);
+        if (ret == -1) return -2;
+        return 0;
+    }
+
+    //  -> ӽֹ̣ͣӣ timeout ڴ;˳
+    // ƽͬһ֤ͨſ֮ǰƽӶѱӽյ
+    int SendDrain(unsigned timeout) {
+        uint32_t message[2] = { PROCESS_CMD_DRAIN, (uint32_t)timeout };
+        ssize_t ret;
+        do {
+            ret = send(pipes[1], message, sizeof(message), MSG_NOSIGNAL);
+        } while (ret == -1 && errno == EINTR);
+        if (ret != sizeof(message)) return -2;
+        return 0;
+    }
+
+    // գfds/addrins  SOCKET_BATCH_MAX count ʵ
+    //  1 ʾյſcount Ϊ 0 DrainTimeout() ȡ
+    int RecvSockets(int* fds, sockaddr_in* addrins, size_t& count) {
+        count = 0;
+        msghdr msg;
+        bzero(&msg, sizeof(msg));
+
+        uint32_t head = 0;
+        iovec iov[2];
+        iov[0].iov_base = &head;
+        iov[0].iov_len = sizeof(head);
+        iov[1].iov_base = addrins;
+        iov[1].iov_len = sizeof(sockaddr_in) * SOCKET_BATCH_MAX;
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+
+        char control[CMSG_SPACE(sizeof(int) * SOCKET_BATCH_MAX)];
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t ret;
+        do {
+            ret = recvmsg(pipes[0], &msg, MSG_CMSG_CLOEXEC);
+        } while (ret == -1 && errno == EINTR);
+        if (ret == -1) return -2;
+        if (ret == 0) return -3; //ѹرͨ
+
+        size_t nfds = 0;
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * nfds);
+        }
+        if ((nfds == 0) && (head == PROCESS_CMD_DRAIN) && ((size_t)ret == sizeof(head) + sizeof(uint32_t))) {
+            memcpy(&m_drain, addrins, sizeof(uint32_t));
+            return 1;
+        }
+        // ַȱ FD һ£ FD ַλ
+        if ((msg.msg_flags & MSG_CTRUNC) || nfds == 0 || head != nfds ||
+            (size_t)ret != sizeof(head) + sizeof(sockaddr_in) * nfds) {
+            for (size_t i = 0; i < nfds; i++) close(fds[i]);
+            return -4;
+        }
+        count = nfds;
+        return 0;
+    }
+
+    // ӽ -> ̣ϱǰأԶʱֱӶ
+    int SendLoad(int load) {
+        if (pipes[0] == -1) return -1;
+        ssize_t ret = send(pipes[0], &load, sizeof(load), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (ret != sizeof(load)) return -2;
+        return 0;
+    }
+
+    // ̶ȡӽϱĸأֻһ 0 ɹ-2 ¼-3 ӽѶϿ
+    // ʽͨܶ¼ 4 ֽڵβ´ƴϣֻļ¼
+    int RecvLoad(int& load) {
+        if (pipes[1] == -1) return -1;
+        char data[sizeof(int) * 64];
+        bool found = false;
+        while (true) {
+            memcpy(data, m_loadPartial, m_loadLength);
+            ssize_t ret = recv(pipes[1], data + m_loadLength, sizeof(data) - m_loadLength, MSG_DONTWAIT);
+            if (ret == 0) return -3;
+            if (ret < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            size_t total = m_loadLength + (size_t)ret;
+            size_t whole = total - total % sizeof(int);
+            if (whole > 0) {//ÿ¼ 4 ֽڣȡһ
+                memcpy(&load, data + whole - sizeof(int), sizeof(int));
+                found = true;
+            }
+            m_loadLength = total - whole;
+            memcpy(m_loadPartial, data + whole, m_loadLength);
+            if (total < sizeof(data)) break;
+        }
+        return found ? 0 : -2;
+    }
+
+    // ʹõͨΪ pipes[1]ӽΪ pipes[0]
+    int LocalPipe() const { return pipes[0] != -1 ? pipes[0] : pipes[1]; }
+    pid_t Pid() const { return m_pid; }
+    // һſЯޣ룩
+    unsigned DrainTimeout() const { return m_drain; }
+
+    // رձеͨӽص̵ֵܽĸ̶ˣ
+    void ClosePipe() {
+        m_loadLength = 0;
+        for (int i = 0; i < 2; i++) {
+            if (pipes[i] != -1) {
+                close(pipes[i]);
+                pipes[i] = -1;
+            }
+        }
+    }
+
     // ̬õǰն˿ƣɺ̨פػ
     static int SwitchDeamon() {
         // һһ fork
@@ -230,7 +543,10 @@ public:
     }
 
 private:
-    CFunctionBase* m_func;
+    CTaskFunction m_func;
     pid_t m_pid;// fork()ӽ ID
+    uint32_t m_drain;//ӽ̣Ҫſ
     int pipes[2];// socketpair ׽־
+    char m_loadPartial[sizeof(int)];//̣ϴ RecvLoad ʣµİؼ¼
+    size_t m_loadLength;//m_loadPartial еЧֽ
 };
@@ -3,29 +3,55 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <deque>
 #include "Public.h"
 
+#define SOCK_HIGHWATER (4 * 1024 * 1024) // ĬϷͶиˮλֽڣ
+
 enum SockAttr {
     SOCK_ISSERVER = 1, // Ƿ1=0=ͻ
     SOCK_ISNONBLOCK = 2, // Ƿ1=0=
     SOCK_ISUDP = 4, // Ƿ UDP1=UDP0=TCP
 	SOCK_ISIP = 8, // Ƿ׽֣1=IP0=
-	SOCK_ISREUSE = 16 // Ƿַã1=0= 
+	SOCK_ISREUSE = 16, // Ƿַã1=0= 
+    SOCK_ISREUSEPORT = 32 // Ƿ˿ڸ(SO_REUSEPORT)1=0=
+};
+
+//TCP ѡ0/false ʾãϵͳĬ
+//ڼ׽úaccept ں˼̳
+class CSockOption {
+public:
+    CSockOption() : nodelay(false), defer_accept(0), fastopen(0), sndbuf(0), rcvbuf(0),
+        keepalive(false), keepidle(0), keepintvl(0), keepcnt(0) {}
+
+public:
+    bool nodelay;      // TCP_NODELAYر NagleСӦ
+    int  defer_accept; // TCP_DEFER_ACCEPT룬յװݺ accept ŷأˣ
+    int  fastopen;     // TCP_FASTOPENTFO гȣˣ
+    int  sndbuf;       // SO_SNDBUFֽ
+    int  rcvbuf;       // SO_RCVBUFֽ
+    bool keepalive;    // SO_KEEPALIVE
+    int  keepidle;     // TCP_KEEPIDLEжʼ̽
+    int  keepintvl;    // TCP_KEEPINTVL̽룩
+    int  keepcnt;      // TCP_KEEPCNT̽ʧܶٴжϿ
 };
 
 //׽ֲװ
 class CSockParam {
 public:
-    CSockParam() : port(-1), attr(0) {
+    CSockParam() : port(-1), attr(0), backlog(32) {
         std::memset(&addr_in, 0, sizeof(addr_in));
         std::memset(&addr_un, 0, sizeof(addr_un));
     }
 
     // ׽ (IPv4)
     CSockParam(const Buffer& ip, short port, int attr)
-        : ip(ip), port(port), attr(attr) {
+        : ip(ip), port(port), attr(attr), backlog(32) {
         std::memset(&addr_in, 0, sizeof(addr_in));
         std::memset(&addr_un, 0, sizeof(addr_un));
 
@@ -41,7 +67,7 @@ public:
 
     // ׽ (Unix Domain Socket)
     CSockParam(const Buffer& path, int attr)
-        : ip(path), port(-1), attr(attr) {
+        : ip(path), port(-1), attr(attr), backlog(32) {
         std::memset(&addr_in, 0, sizeof(addr_in));
         std::memset(&addr_un, 0, sizeof(addr_un));
 
@@ -52,7 +78,7 @@ public:
     }
 
     //  sockaddr_in 
-    CSockParam(const sockaddr_in* addrin, int attr) : port(-1), attr(attr) {
+    CSockParam(const sockaddr_in* addrin, int attr) : port(-1), attr(attr), backlog(32) {
         std::memset(&addr_in, 0, sizeof(addr_in));
         std::memset(&addr_un, 0, sizeof(addr_un));
 
@@ -79,6 +105,8 @@ public:
     Buffer ip;   // ip  unix pathڲ֤ '\0'
     short  port;
     int    attr;
+    int    backlog; // listen гȣˣ
+    CSockOption option; // TCP ѡ SOCK_ISIP ҷ UDP ʱЧ
 };
 
 class CSocketBase {
@@ -86,6 +114,7 @@ public:
     CSocketBase() {
         m_socket = -1;
         m_status = 0; // ʼδ
+        m_highwater = SOCK_HIGHWATER;
     }
 
     virtual ~CSocketBase() { Close(); }
@@ -103,6 +132,34 @@ public:
     virtual int Send(const Buffer& data) = 0;
     // 
     virtual int Recv(Buffer& data) = 0;
+    // ׷ӽգ data ĩβ chunk ֽ
+    // >0 ֽ0 (EAGAIN)-2 -3 Զ˹ر
+    virtual int RecvAppend(Buffer& /*data*/, size_t /*chunk*/ = 4096) { return -1; }
+    // ѷͶлѹд>0 лѹֽ0 д꣬<0 
+    virtual int Flush() { return 0; }
+    // Ͷδдֽ
+    virtual size_t Pending() const { return 0; }
+    // ļ fd  *offset  count ֱֽӷ㿽*offset ֮ǰƣͶΪ
+    // >=0 дֽ count ʱ EPOLLOUT <0 
+    virtual ssize_t SendFile(int /*fd*/, off_t* /*offset*/, size_t /*count*/) { return -1; }
+    // ÷Ͷиˮλ Send ܾŶ
+    void SetHighWater(size_t size) { m_highwater = size; }
+    // Ƿ񱾵׽֣AF_UNIX
+    bool IsLocal() const { return (m_param.attr & SOCK_ISIP) == 0; }
+    // ׽ӣȡԶ˽̵ pid/uid/gidSO_PEERCREDconnect ʱں˼¼ƽЧ
+    int PeerCred(ucred& cred) const {
+        if (m_socket == -1) return -1;
+        socklen_t len = sizeof(cred);
+        if (getsockopt(m_socket, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) return -2;
+        return 0;
+    }
+    // ײ fdٹرڰ accept ӻ CSocketBase 
+    int Detach() {
+        int fd = m_socket;
+        m_socket = -1;
+        m_status = 3;
+        return fd;
+    }
     // ر
     virtual int Close() {
         m_status = 3;
@@ -124,6 +181,7 @@ protected:
     int m_socket;   // ׽
     int m_status;   // 0:δ 1:ʼ 2: 3:ѹر
     CSockParam m_param; // ʼ
+    size_t m_highwater; // Ͷиˮλ
 };
 
 class CSocket : public CSocketBase {
@@ -156,6 +214,17 @@ public:
             if (ret == -1) return -7;
         }
 
+        if (m_param.attr & SOCK_ISREUSEPORT) { // ˿ڸã̸ bind ͬһ˿ڣں˷ַ
+            int option = 1;
+            ret = setsockopt(m_socket, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option));
+            if (ret == -1) return -8;
+        }
+
+        if (m_status == 0) { // ½׽ֲãaccept õѴӼ׽ּ̳
+            ret = SetOption();
+            if (ret != 0) return -9;
+        }
+
         if (m_param.attr & SOCK_ISSERVER) { // bind + listen
             if (m_param.attr & SOCK_ISIP) {
 				ret = bind(m_socket, m_param.addrin(), sizeof(sockaddr_in));//׽
@@ -164,7 +233,7 @@ public:
 				ret = bind(m_socket, m_param.addrun(), sizeof(sockaddr_un));//׽
             }
             if (ret == -1) return -3;
-            ret = listen(m_socket, 32); // 
+            ret = listen(m_socket, m_param.backlog); // 
             if (ret == -1) return -4;
         }
 
@@ -192,24 +261,30 @@ public:
             CSockParam param;               // նԶ˵ַ
 			socklen_t len = 0;
             int fd = -1;
+            // accept4 ֱӴ CLOEXEC׽ȡͬʡȥ fcntl
+            int flags = SOCK_CLOEXEC;
+            if (m_param.attr & SOCK_ISNONBLOCK) flags |= SOCK_NONBLOCK;
             if (m_param.attr & SOCK_ISIP) {
 				param.attr |= SOCK_ISIP;
+                param.option = m_param.option; // ¼̳Լ׽ֵѡ
                 len = sizeof(sockaddr_in);
-				fd = accept(m_socket, param.addrin(), &len); //׽
+				fd = accept4(m_socket, param.addrin(), &len, flags); //׽
             } else {
                 len = sizeof(sockaddr_un);
-				fd = accept(m_socket, param.addrun(), &len); //׽ 
+				fd = accept4(m_socket, param.addrun(), &len, flags); //׽ 
             }
-            if (fd == -1) return -3;
+            if (fd == -1) return -3; // ʱ EAGAIN ʾȡ
 
-            *pClient = new CSocket(fd);
-            if (*pClient == NULL) return -4;
-            ret = (*pClient)->Init(param);   // ʼͻsocket
+            CSocket* client = new CSocket(fd);
+            if (client == NULL) return -4;
+            ret = client->Init(param);   // ʼͻsocket
             if (ret != 0) {
-                delete (*pClient);
+                delete client;
                 *pClient = NULL;
                 return -5;
             }
+            if (flags & SOCK_NONBLOCK) client->m_param.attr |= SOCK_ISNONBLOCK;
+            *pClient = client;
         }else { // ͻˣconnect
             if (m_param.attr & SOCK_ISIP) {
                 ret = connect(m_socket, m_param.addrin(), sizeof(sockaddr_in));
@@ -223,21 +298,75 @@ public:
         return 0;
     }
 
+    // 0 ȫд1 ں˻ʣಿֽ뷢ͶУȴ EPOLLOUT  Flush
+    // -4 ͶгˮλδŶӣ÷ӦֹͣϿ
     virtual int Send(const Buffer& data) {
         if (m_status < 2 || (m_socket == -1)) return -1; // δ/Чfd
 
         size_t index = 0;
-        while (index < data.size()) { // ѭֱ
-            ssize_t len = write(m_socket, (const char*)data + index, data.size() - index);
-            if (len == 0) return -2; // һ㲻֣д0ֽ
-            if (len < 0) {           // 
-                if (errno == EINTR) continue; // źŴϣ
-                if (errno == EAGAIN || errno == EWOULDBLOCK) return 0; // ʱд
-                return -3; // 
+        if (m_outsize == 0) {
+            while (index < data.size()) { // ѭֱ
+                ssize_t len = send(m_socket, (const char*)data + index, data.size() - index, MSG_NOSIGNAL);
+                if (len == 0) return -2; // һ㲻֣д0ֽ
+                if (len < 0) {           // 
+                    if (errno == EINTR) continue; // źŴϣ
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) break; // ʱдʣಿŶ
+                    return -3; // 
+                }
+                index += len;
             }
-            index += len;
+            if (index == data.size()) return 0;
+        }
+        // лѹʱں棬ֽ֤˳
+        size_t rest = data.size() - index;
+        if (m_outsize + rest > m_highwater) return -4;
+        m_outq.emplace_back((const char*)data + index, rest);
+        m_outsize += rest;
+        return 1;
+    }
+
+    virtual int Flush() {
+        if (m_status < 2 || (m_socket == -1)) return -1;
+        while (m_outsize > 0) {
+            iovec iov[64];
+            int count = 0;
+            for (auto it = m_outq.begin(); it != m_outq.end() && count < 64; ++it, ++count) {
+                size_t skip = (count == 0) ? m_outoffset : 0; // ׿дһ
+                iov[count].iov_base = (char*)(*it) + skip;
+                iov[count].iov_len = it->size() - skip;
+            }
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            ssize_t len = sendmsg(m_socket, &msg, MSG_NOSIGNAL); // ͬ writevᴥ SIGPIPE
+            if (len < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                return -3;
+            }
+            m_outsize -= len;
+            size_t written = (size_t)len + m_outoffset;
+            while (!m_outq.empty() && written >= m_outq.front().size()) {
+                written -= m_outq.front().size();
+                m_outq.pop_front();
+            }
+            m_outoffset = written;
+        }
+        return (int)m_outsize;
+    }
+
+    virtual size_t Pending() const { return m_outsize; }
+
+    virtual ssize_t SendFile(int fd, off_t* offset, size_t count) {
+        if (m_status < 2 || (m_socket == -1) || (m_outsize > 0)) return -1;
+        while (true) {
+            ssize_t len = sendfile(m_socket, fd, offset, count);
+            if (len >= 0) return len;
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -3;
         }
-        return 0;
     }
 
     // >0 յֽ0 ûݵ޴<0 /Ͽ
@@ -258,7 +387,54 @@ public:
         return -3; // len==0Զ˹ر
     }
 
+    virtual int RecvAppend(Buffer& data, size_t chunk = 4096) {
+        if (m_status < 2 || (m_socket == -1)) return -1; // δ/Чfd
+
+        size_t size = data.size();
+        while (true) {
+            ssize_t len = read(m_socket, data.writable_tail(chunk), chunk);
+            if (len > 0) {
+                data.resize(size + len);
+                return (int)len;
+            }
+            if (len == 0) return -3;      // Զ˹ر
+            if (errno == EINTR) continue; // źŴϣԣش²ܰ EAGAIN
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -2;
+        }
+    }
+
     virtual int Close() {
+        m_outq.clear(); // δд
+        m_outsize = 0;
+        m_outoffset = 0;
         return CSocketBase::Close(); // رfd״̬
     }
+
+protected:
+    //  m_param.option  TCP ѡ TFO  listen ֮ǰ
+    int SetOption() {
+        if (!(m_param.attr & SOCK_ISIP) || (m_param.attr & SOCK_ISUDP)) return 0;
+        const CSockOption& opt = m_param.option;
+        int value = 1;
+        if (opt.nodelay && setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) == -1) return -1;
+        if (opt.sndbuf > 0 && setsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, &opt.sndbuf, sizeof(opt.sndbuf)) == -1) return -2;
+        if (opt.rcvbuf > 0 && setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &opt.rcvbuf, sizeof(opt.rcvbuf)) == -1) return -3;
+        if (opt.keepalive) {
+            if (setsockopt(m_socket, SOL_SOCKET, SO_KEEPALIVE, &value, sizeof(value)) == -1) return -4;
+            if (opt.keepidle > 0 && setsockopt(m_socket, IPPROTO_TCP, TCP_KEEPIDLE, &opt.keepidle, sizeof(opt.keepidle)) == -1) return -5;
+            if (opt.keepintvl > 0 && setsockopt(m_socket, IPPROTO_TCP, TCP_KEEPINTVL, &opt.keepintvl, sizeof(opt.keepintvl)) == -1) return -6;
+            if (opt.keepcnt > 0 && setsockopt(m_socket, IPPROTO_TCP, TCP_KEEPCNT, &opt.keepcnt, sizeof(opt.keepcnt)) == -1) return -7;
+        }
+        if (m_param.attr & SOCK_ISSERVER) {
+            if (opt.defer_accept > 0 && setsockopt(m_socket, IPPROTO_TCP, TCP_DEFER_ACCEPT, &opt.defer_accept, sizeof(opt.defer_accept)) == -1) return -8;
+            if (opt.fastopen > 0 && setsockopt(m_socket, IPPROTO_TCP, TCP_FASTOPEN, &opt.fastopen, sizeof(opt.fastopen)) == -1) return -9;
+        }
+        return 0;
+    }
+
+protected:
+    std::deque<Buffer> m_outq; // Ͷ
+    size_t m_outsize = 0;      // δдֽ
+    size_t m_outoffset = 0;    //  Buffer дֽ
 };
\ No newline at end of file
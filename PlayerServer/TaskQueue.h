@@ -0,0 +1,290 @@
+#pragma once
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <vector>
+
+#define TASK_QUEUE_SIZE 4096   //任务队列容量（须为 2 的幂），满了 AddTask 直接返回错误
+#define TASK_DEQUE_SIZE 1024   //工作窃取模式下每个线程本地双端队列的容量（须为 2 的幂），满了退回全局队列
+#define TASK_CACHELINE 64      //生产端与消费端游标各占一个缓存行，互不失效
+
+/*
+* 有界无锁多生产者多消费者队列（Vyukov 环形队列）
+* 每个槽位带一个序号：序号 == 入队位置 表示空闲可写，== 位置+1 表示已写好可读
+* 入队/出队各只有一次 CAS 抢位置，没有锁也不进内核；T 须可平凡拷贝（这里存的是指针）
+*/
+template<typename T>
+class CMpmcQueue {
+public:
+    explicit CMpmcQueue(size_t size = TASK_QUEUE_SIZE) : m_cells(Round(size)), m_mask(m_cells.size() - 1) {
+        for (size_t i = 0; i < m_cells.size(); i++) m_cells[i].seq.store(i, std::memory_order_relaxed);
+        m_enqueue.store(0, std::memory_order_relaxed);
+        m_dequeue.store(0, std::memory_order_relaxed);
+    }
+    CMpmcQueue(const CMpmcQueue&) = delete;
+    CMpmcQueue& operator=(const CMpmcQueue&) = delete;
+
+public:
+    //队列满时返回 false
+    bool Push(const T& value) {
+        size_t pos = m_enqueue.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0) return false;//这一圈的槽位还没被消费
+            else pos = m_enqueue.load(std::memory_order_relaxed);
+        }
+        cell->value = value;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    //队列空时返回 false
+    bool Pop(T& value) {
+        size_t pos = m_dequeue.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0) return false;//生产者还没写到这里
+            else pos = m_dequeue.load(std::memory_order_relaxed);
+        }
+        value = cell->value;
+        cell->seq.store(pos + m_mask + 1, std::memory_order_release);//留给下一圈的生产者
+        return true;
+    }
+
+    size_t Capacity() const { return m_cells.size(); }
+
+private:
+    static size_t Round(size_t size) {
+        size_t n = 2;
+        while (n < size) n <<= 1;
+        return n;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+    std::vector<Cell> m_cells;
+    size_t m_mask;
+    alignas(TASK_CACHELINE) std::atomic<size_t> m_enqueue;
+    alignas(TASK_CACHELINE) std::atomic<size_t> m_dequeue;
+};
+
+/*
+* Chase-Lev 工作窃取双端队列（有界，按 Lê 等人的 C11 内存序版本）
+* 只有所属线程在底部 Push/Pop（后进先出，刚产生的子任务趁缓存还热先执行），其他线程从顶部 Steal（先进先出）
+* 只有队列剩最后一个元素时所属线程才需要和窃取者 CAS 竞争
+*/
+template<typename T>
+class CWorkDeque {
+public:
+    explicit CWorkDeque(size_t size = TASK_DEQUE_SIZE) : m_cells(Round(size)), m_mask(m_cells.size() - 1) {
+        m_top.store(0, std::memory_order_relaxed);
+        m_bottom.store(0, std::memory_order_relaxed);
+    }
+    CWorkDeque(const CWorkDeque&) = delete;
+    CWorkDeque& operator=(const CWorkDeque&) = delete;
+
+public:
+    //仅所属线程调用，满时返回 false
+    bool Push(const T& value) {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        if (b - t > (int64_t)m_mask) return false;
+        m_cells[b & m_mask].store(value, std::memory_order_relaxed);
+        m_bottom.store(b + 1, std::memory_order_release);//窃取者 acquire 读到 bottom 后才读槽位
+        return true;
+    }
+
+    //仅所属线程调用，空时返回 false
+    bool Pop(T& value) {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        if (t > b) {//已空
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        value = m_cells[b & m_mask].load(std::memory_order_relaxed);
+        if (t == b) {//最后一个：与窃取者抢
+            bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    //任意线程调用，空或与其他线程竞争失败时返回 false
+    bool Steal(T& value) {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b) return false;
+        value = m_cells[t & m_mask].load(std::memory_order_relaxed);
+        return m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    //粗略判断是否为空，供睡眠前检查
+    bool Empty() const {
+        return m_bottom.load(std::memory_order_acquire) <= m_top.load(std::memory_order_acquire);
+    }
+
+private:
+    static size_t Round(size_t size) {
+        size_t n = 2;
+        while (n < size) n <<= 1;
+        return n;
+    }
+
+private:
+    std::vector<std::atomic<T>> m_cells;
+    size_t m_mask;
+    alignas(TASK_CACHELINE) std::atomic<int64_t> m_top;
+    alignas(TASK_CACHELINE) std::atomic<int64_t> m_bottom;
+};
+
+/*
+* 空闲线程的睡眠/唤醒（事件计数 + futex）
+* 消费者：key = Prepare() -> 再查一次队列 -> 取到任务则 Cancel，仍为空才 Wait(key)（返回前自动 Cancel）
+* 生产者：入队后 Notify；没有线程在睡眠时只是一次原子读，不进内核
+* Prepare 先登记为空闲再查队列，生产者先入队再看空闲数，两边都是顺序一致的原子操作，不会丢唤醒
+*/
+class CEventCount {
+public:
+    CEventCount() : m_seq(0), m_idle(0) {}
+    CEventCount(const CEventCount&) = delete;
+    CEventCount& operator=(const CEventCount&) = delete;
+
+public:
+    int Prepare() {
+        int key = m_seq.load(std::memory_order_seq_cst);
+        m_idle.fetch_add(1, std::memory_order_seq_cst);
+        return key;
+    }
+    void Cancel() { m_idle.fetch_sub(1, std::memory_order_seq_cst); }
+    //Notify 在 Prepare 之后发生过则立即返回
+    void Wait(int key) {
+        syscall(SYS_futex, &m_seq, FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+        Cancel();
+    }
+    //唤醒至多 count 个空闲线程
+    void Notify(int count = 1) {
+        //入队的写可能只是 release，先用全屏障隔开，保证与消费者的"登记空闲后再查队列"至少有一方看到对方
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_idle.load(std::memory_order_seq_cst) == 0) return;
+        m_seq.fetch_add(1, std::memory_order_seq_cst);
+        syscall(SYS_futex, &m_seq, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+    void NotifyAll() {
+        m_seq.fetch_add(1, std::memory_order_seq_cst);
+        syscall(SYS_futex, &m_seq, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+private:
+    std::atomic<int> m_seq;  //futex 字：每次通知加一
+    std::atomic<int> m_idle; //已登记、可能正在睡眠的线程数
+};
+
+/*
+* 一组任务的完成计数（调用方持有，状态就在这个对象里，不像 std::future 那样另外分配共享状态）
+* 线程池投递前 Add，任务执行完 Finish(返回值)；Wait 用 futex 等计数归零，返回组内第一个非 0 的返回值
+* 组内任务全部结束之前不能析构，析构函数会先等待
+*/
+class CTaskGroup {
+public:
+    CTaskGroup() : m_pending(0), m_releasing(0), m_result(0) {}
+    ~CTaskGroup() { Wait(); }
+    CTaskGroup(const CTaskGroup&) = delete;
+    CTaskGroup& operator=(const CTaskGroup&) = delete;
+
+public:
+    int Pending() const { return m_pending.load(std::memory_order_seq_cst); }
+    //任务全部完成，且完成方都已离开本对象：此后可以析构
+    bool Done() const { return (Pending() == 0) && (m_releasing.load(std::memory_order_seq_cst) == 0); }
+    int Result() const { return m_result.load(std::memory_order_acquire); }
+
+    int Wait() {
+        int pending = 0;
+        while ((pending = Pending()) != 0) {
+            syscall(SYS_futex, &m_pending, FUTEX_WAIT_PRIVATE, pending, nullptr, nullptr, 0);
+        }
+        Settle();
+        return Result();
+    }
+
+    //最多等 ms 毫秒，返回是否全部完成
+    bool WaitFor(int ms) {
+        int pending = Pending();
+        if (pending != 0) {
+            timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+            syscall(SYS_futex, &m_pending, FUTEX_WAIT_PRIVATE, pending, &ts, nullptr, 0);
+            if (Pending() != 0) return false;
+        }
+        Settle();
+        return true;
+    }
+
+    //全部完成后才能调用，清掉上一轮的返回值以便复用
+    void Reset() {
+        if (Done()) m_result.store(0, std::memory_order_relaxed);
+    }
+
+public://以下由线程池调用
+    void Add(int count = 1) { m_pending.fetch_add(count, std::memory_order_relaxed); }
+    //投递失败，撤销 Add，不记录返回值
+    bool Cancel() { return Release(); }
+    //返回 true 表示这是组内最后一个任务；返回后调用方不能再访问本对象
+    bool Finish(int result) {
+        if (result != 0) {
+            int expect = 0;
+            m_result.compare_exchange_strong(expect, result, std::memory_order_relaxed);
+        }
+        return Release();
+    }
+
+private:
+    //m_pending 归零后最后一个完成方还要 FUTEX_WAKE 它：先在 m_releasing 登记，唤醒之后再注销，
+    //注销是对本对象的最后一次访问；等待方要看到 m_releasing 也归零才返回，之后析构是安全的
+    bool Release() {
+        m_releasing.fetch_add(1, std::memory_order_seq_cst);
+        bool last = (m_pending.fetch_sub(1, std::memory_order_seq_cst) == 1);
+        if (last) syscall(SYS_futex, &m_pending, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+        m_releasing.fetch_sub(1, std::memory_order_seq_cst);
+        return last;
+    }
+
+    //任务数已归零，等完成方走完 Release：只差一次 FUTEX_WAKE，让出 CPU 即可
+    void Settle() const {
+        while (m_releasing.load(std::memory_order_seq_cst) != 0) sched_yield();
+    }
+
+private:
+    std::atomic<int> m_pending;   //futex 字：未完成的任务数
+    std::atomic<int> m_releasing; //正在 Release 中的完成方个数
+    std::atomic<int> m_result;    //第一个非 0 的任务返回值
+};
+
+//单个任务的结果：Get 等待任务结束并返回它的返回值；一次只能挂一个任务
+class CTaskFuture : public CTaskGroup {
+public:
+    int Get() { return Wait(); }
+};
@@ -7,33 +7,48 @@
 #include "Function.h"
 #include <cstdio>
 #include <errno.h>
+#include <sched.h>
 #include <memory>
+#include <vector>
+#include <atomic>
+#include <time.h>
+#include "Public.h"
+
+//߳ԣ/0 ʾã pthread Ĭ
+class CThreadParam {
+public:
+    CThreadParam() : stacksize(0), policy(SCHED_OTHER), priority(0) {}
+
+public:
+    Buffer name;           // pthread_setname_np ߳ perf/top ʶ𣬳 15 ֽڽض
+    std::vector<int> cpus; // е CPU ţձʾ
+    size_t stacksize;      // ջСֽڣС PTHREAD_STACK_MIN
+    int policy;            // ȲԣSCHED_OTHER/SCHED_FIFO/SCHED_RRʵʱҪ CAP_SYS_NICE
+    int priority;          // SCHED_FIFO/SCHED_RR ľ̬ȼ
+};
 
 class CThread
 {
 public:
     CThread()
     {
-        m_function = nullptr;     // ִ߳к
         m_thread = 0;          // pthread ߳ID0ʾδ
+        m_handle = 0;
         m_bpaused = false;     // ͣ־
     }
 
     // ʱִ߳к
     template<typename _FUNCTION_, typename... _ARGS_>
     CThread(_FUNCTION_ func, _ARGS_... args)
-        : m_function(new CFunction<_FUNCTION_, _ARGS_...>(func, args...))
+        : m_function(func, args...)
     {
         m_thread = 0;
+        m_handle = 0;
         m_bpaused = false;
     }
 
-    ~CThread() {
-        if (m_function != NULL) {
-            delete m_function;
-            m_function = NULL;
-        }
-    }
+    // ߳ʱأͷŵĶ̺߳˳ǿɱ
+    ~CThread() { Join(); }
 
 public:
     CThread(const CThread&) = delete;
@@ -44,15 +59,26 @@ public:
     template<typename _FUNCTION_, typename... _ARGS_>
     int SetThreadFunc(_FUNCTION_ func, _ARGS_... args)
     {
-        if (m_function != NULL) {
-            delete m_function;
-            m_function = NULL;
-        }
-        m_function = new CFunction<_FUNCTION_, _ARGS_...>(func, args...);
-        if (m_function == NULL) return -1;
+        m_function = CTaskFunction(func, args...);
         return 0;
     }
 
+    // ߳ԣ Start ֮ǰ
+    void SetParam(const CThreadParam& param) { m_param = param; }
+
+    // ̿õ CPUsched_getaffinity taskset/cgroup ƣ
+    static std::vector<int> AvailableCpus()
+    {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+        for (int i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &set)) cpus.push_back(i);
+        }
+        return cpus;
+    }
+
     // ߳
     int Start()
     {
@@ -71,6 +97,12 @@ public:
         /*ret = pthread_attr_setscope(&attr, PTHREAD_SCOPE_PROCESS);
         if (ret != 0) return -3;*/
 
+        ret = SetAttr(&attr);
+        if (ret != 0) {
+            pthread_attr_destroy(&attr);
+            return ret;
+        }
+
         // ̣߳Ϊ̬
         /*
         pthread_create(
@@ -80,12 +112,21 @@ public:
             void* arg                     //̵߳Ĳ
         );
         */
+        m_joining = false;
         ret = pthread_create(&m_thread, &attr, &CThread::ThreadEntry, this);
         if (ret != 0) return -4;
+        m_handle = m_thread;
 
         // ¼߳IDӳ䣨źŻصҵ
         m_mapThread[m_thread] = this;
 
+        // ֻ߳ڴãʧܲӰ
+        if (m_param.name.size() > 0) {
+            char name[16] = "";
+            strncpy(name, m_param.name, sizeof(name) - 1);
+            pthread_setname_np(m_thread, name);
+        }
+
         ret = pthread_attr_destroy(&attr);
         if (ret != 0) return -5;
 
@@ -116,17 +157,39 @@ public:
         return 0;
     }
 
-    // ֹͣ߳
+    // ̺߳зأ÷֪ͨ˳رȴ epoll賬ʱź
+    // ߳з˳ʱ
+    int Join()
+    {
+        if (m_handle == 0) return 0;
+        pthread_t thread = m_handle;
+        m_handle = 0;
+        m_thread = 0;   // ̼߳
+        if (m_joining.exchange(true)) return 0;
+        return (pthread_join(thread, NULL) == 0) ? 0 : -1;
+    }
+
+    // ֹ̣ͣ߳ 100msʱǿ˳
+    // ǿ˳ִ߳룬ҲͷеֻڿԶ̣߳־̣߳
     int Stop()
     {
-        if (m_thread != 0)
+        if (m_handle != 0)
         {
-            pthread_t thread = m_thread;
+            pthread_t thread = m_handle;
+            m_handle = 0;
             m_thread = 0;   // ̼߳
 
+            // ߳Ѿз˳ join
+            if (m_joining.exchange(true)) return 0;
+
+            // pthread_timedjoin_np ĳʱ CLOCK_REALTIME ʱ
             timespec ts;
-            ts.tv_sec = 0;
-            ts.tv_nsec = 100 * 1000000; // ȴ100ms
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 100 * 1000000; // ȴ100ms
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
 
             // ʱ joinGNU չ
             int ret = pthread_timedjoin_np(thread, NULL, &ts);//ȴ߳̽
@@ -146,6 +209,36 @@ public:
         return m_thread != 0;
     }
 private:
+    //  m_param еջСȲԺ CPU д߳
+    int SetAttr(pthread_attr_t* attr)
+    {
+        int ret = 0;
+        if (m_param.stacksize > 0) {
+            ret = pthread_attr_setstacksize(attr, m_param.stacksize);
+            if (ret != 0) return -7;
+        }
+        if (m_param.policy != SCHED_OTHER) {// Ĭϼ̳дߵĵȲԣʽָЧ
+            ret = pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+            if (ret != 0) return -8;
+            ret = pthread_attr_setschedpolicy(attr, m_param.policy);
+            if (ret != 0) return -8;
+            sched_param sp;
+            sp.sched_priority = m_param.priority;
+            ret = pthread_attr_setschedparam(attr, &sp);
+            if (ret != 0) return -8;
+        }
+        if (!m_param.cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : m_param.cpus) {
+                if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+            }
+            ret = pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+            if (ret != 0) return -9;
+        }
+        return 0;
+    }
+
     // ߳ں̬
     static void* ThreadEntry(void* arg)
     {
@@ -174,7 +267,9 @@ private:
         if (it != m_mapThread.end())
             m_mapThread[thread] = NULL;
 
-        pthread_detach(thread);
+        //  Stop ѡһû join з룻һη thiz֮ʱܱͷ
+        if (!thiz->m_joining.exchange(true))
+            pthread_detach(thread);
         pthread_exit(NULL);
     }
 
@@ -213,9 +308,9 @@ private:
     // ʵִк
     void EnterThread()
     {
-        if (m_function != NULL)
+        if (m_function)
         {
-            int ret = (*m_function)();
+            int ret = m_function();
             if (ret != 0)
             {
                 printf("%s(%d):[%s]ret = %d\n",__FILE__, __LINE__, __FUNCTION__, ret);
@@ -223,8 +318,11 @@ private:
         }
     }
 private:
-    CFunctionBase* m_function;               // װִ߳к
-    pthread_t m_thread;                      // ߳ID
+    CTaskFunction m_function;                // װִ߳к
+    pthread_t m_thread;                      // ߳ID߳˳ Stop ʱ
+    pthread_t m_handle;                      //  Stop յ߳IDֻ Stop 
+    std::atomic<bool> m_joining;             // Stop ߳˳˭λStop  join߳з
     bool m_bpaused;                          // ͣ־
+    CThreadParam m_param;                    // ߳
     static std::map<pthread_t, CThread*> m_mapThread; // ߳IDӳ
 };
@@ -3,27 +3,94 @@
 #include "Thread.h"
 #include "Function.h"
 #include "Socket.h"
+#include "TaskQueue.h"
+
+//̳߳صĵȷʽ
+enum PoolScheduler {
+    POOL_SHARED = 0,  //̹߳һȫֶ
+    POOL_STEALING = 1 //ÿ߳һ Chase-Lev ˫˶У߳ AddTask ŽԼĶУʱȡ̵߳
+};
+
+//ȼAddTask ʱָָΪ TASK_NORMALÿȼһȫֶ
+enum TaskPriority {
+    TASK_HIGH = 0,   //󣨵¼ȣӳ
+    TASK_NORMAL = 1, //Ĭϣȡģʽ³̵߳ıضйһ
+    TASK_LOW = 2,    //̨ά־ˢ̡Ԥȡͳд룩
+    TASK_PRIORITIES = 3
+};
+
+//AddTask ĵһȼʱ
+template<typename _T_>
+struct IsTaskOption : std::integral_constant<bool,
+    std::is_base_of<CTaskGroup, typename std::decay<_T_>::type>::value ||
+    std::is_same<typename std::decay<_T_>::type, TaskPriority>::value> {};
+
+//̳߳ԣ i ߳Ϊ "<name>-<first+i>" cpus[(first+i) % cpus.size()]
+class CPoolParam {
+public:
+    CPoolParam(const Buffer& name = "") : name(name), first(0), scheduler(POOL_SHARED) {
+        for (int i = 0; i < TASK_PRIORITIES; i++) {
+            weights[i] = 0;
+            limits[i] = 0;
+        }
+    }
 
-//׽ (Unix Domain Socket) + Epoll ַ
-class CThreadPool
-{
 public:
-    CThreadPool() : m_server(nullptr)
-    {
-        timespec tp{ 0, 0 };
-        clock_gettime(CLOCK_REALTIME, &tp);
+    Buffer name;           // ߳ǰ׺ձʾ
+    std::vector<int> cpus; // ߳̿ CPUձʾ
+    unsigned first;        // һ̵߳ȫţ̵̳߳عһ CPU ʱݴ˴
+    CThreadParam thread;   // ջСȲԣname/cpus 漸߳
+    int scheduler;         // PoolScheduler
+    unsigned weights[TASK_PRIORITIES]; // ȨأȫΪ 0 ʱϸȼӣȨؼȨתȨΪ 0 ֻȼȡʱִ
+    unsigned limits[TASK_PRIORITIES];  // ȼͬʱִеޣ0 ޣֹ̨ռ߳
+};
+
+//CPU ԣ̿ CPU ǰ reserved ̡߳־̵߳ϵͳ̣߳Ϊҵ
+//reserved Ϊ 0 CPU  reserved ʱ룬鶼Ϊգ󶨣
+class CCpuPolicy {
+public:
+    explicit CCpuPolicy(unsigned reserved = 0) : m_reserved(reserved) {}
 
-        char* buf = nullptr;
-        asprintf(&buf, "%d.%d.sock",
-            tp.tv_sec % 100000,
-            tp.tv_nsec % 1000000);
+public:
+    std::vector<int> SystemCpus() const {
+        std::vector<int> cpus = Available();
+        if (cpus.empty()) return cpus;
+        cpus.resize(m_reserved);
+        return cpus;
+    }
+    std::vector<int> BusinessCpus() const {
+        std::vector<int> cpus = Available();
+        if (cpus.empty()) return cpus;
+        cpus.erase(cpus.begin(), cpus.begin() + m_reserved);
+        return cpus;
+    }
 
-        if (buf != nullptr) {
-            m_path = buf;
-            free(buf);
+private:
+    std::vector<int> Available() const {
+        if (m_reserved == 0) return std::vector<int>();
+        std::vector<int> cpus = CThread::AvailableCpus();
+        if (cpus.size() <= m_reserved) cpus.clear();
+        return cpus;
+    }
+
+private:
+    unsigned m_reserved;
+};
+
+//нַAddTask Ӽأֻ߳̿˯ʱ futex һ
+//ֻڱת fork ֮ǰҲ޷ɸӽ̷ֱ Start
+//ȡģʽⲿ߳ͶݵԽȫֶУ߳ͶݵĽԼ˫˶У
+//ȡ˳ԼĶУȳ-> ȫֶ -> λȡ߳
+//ȼÿһȫֶУ CPoolParam::weights ϸȨȲһﵽ limits ޵ļʱ
+class CThreadPool
+{
+public:
+    CThreadPool() : m_running(false), m_helpers(0), m_scheduler(POOL_SHARED), m_weighted(false) {
+        for (int i = 0; i < TASK_PRIORITIES; i++) {
+            m_weights[i] = 0;
+            m_limits[i] = 0;
+            m_busy[i] = 0;
         }
-        // ʧܣ Start() ͨ m_path ж
-        usleep(1);
     }
 
     ~CThreadPool() { Close(); }
@@ -33,30 +100,38 @@ public:
 
 public:
     size_t Size() const{return m_threads.size();}
-    int Start(unsigned count)
+    int Start(unsigned count, const CPoolParam& param = CPoolParam())
     {
         int ret = 0;
 
-        if (m_server != nullptr) return -1;   // ѳʼ
-        if (m_path.size() == 0) return -2;    // ʧ
-
-        m_server = new CSocket();
-        if (m_server == nullptr) return -3;
-
-        ret = m_server->Init(CSockParam(m_path, SOCK_ISSERVER));
-        if (ret != 0) return -4;
-
-        ret = m_epoll.Create(count);
-        if (ret != 0) return -5;
-
-        ret = m_epoll.Add(*m_server, EpollData((void*)m_server));
-        if (ret != 0) return -6;
+        if (m_running || !m_threads.empty()) return -1;   // ѳʼ
+        m_running = true;
+        m_scheduler = param.scheduler;
+        m_weighted = false;
+        for (int i = 0; i < TASK_PRIORITIES; i++) {
+            m_weights[i] = param.weights[i];
+            m_limits[i] = param.limits[i];
+            if (m_weights[i] > 0) m_weighted = true;
+        }
+        if (m_scheduler == POOL_STEALING) {// ߳ǰ˫˶Уȡʱ
+            for (unsigned i = 0; i < count; ++i) m_deques.push_back(new CWorkDeque<Task*>());
+        }
 
         m_threads.resize(count);
         for (unsigned i = 0; i < count; ++i) {
-            m_threads[i] = new CThread(&CThreadPool::TaskDispatch, this);
+            m_threads[i] = new CThread(&CThreadPool::TaskDispatch, this, (size_t)i);
             if (m_threads[i] == nullptr) return -7;
 
+            CThreadParam attr = param.thread;
+            if (param.name.size() > 0) {
+                char name[16] = "";
+                snprintf(name, sizeof(name), "%s-%u", (const char*)param.name, param.first + i);
+                attr.name = name;
+            }
+            if (!param.cpus.empty()) {
+                attr.cpus.assign(1, param.cpus[(param.first + i) % param.cpus.size()]);
+            }
+            m_threads[i]->SetParam(attr);
             ret = m_threads[i]->Start();
             if (ret != 0) return -8;
         }
@@ -66,109 +141,331 @@ public:
 
     void Close()
     {
-        m_epoll.Close();
-
-        if (m_server) {
-            CSocketBase* p = m_server;
-            m_server = nullptr;
-            delete p;
-        }
-
+        m_running = false;
+        m_event.NotifyAll();
+        //  join ֮ͷŶУִеֹͣȹصȴ epoll
+        // ǿɱ̣߳鲻еҲͷ
         for (auto thread : m_threads) {
-            if (thread) delete thread;
+            if (thread) {
+                thread->Join();
+                delete thread;
+            }
         }
         m_threads.clear();
 
-        unlink(m_path);
+        // ûüִеڵ鰴ֵ -1 ȴ߲Զס
+        Task* task = nullptr;
+        for (int i = 0; i < TASK_PRIORITIES; i++) {
+            while (m_queues[i].Pop(task)) Drop(task);
+        }
+        for (auto deque : m_deques) {
+            while (deque->Pop(task)) Drop(task);
+            delete deque;
+        }
+        m_deques.clear();
+        while (m_free.Pop(task)) delete task;
     }
 
     // ģ庯Ͷǩĺִ̳߳
     template<typename _FUNCTION_, typename... _ARGS_>
-    int AddTask(_FUNCTION_ func, _ARGS_... args)
+    typename std::enable_if<!IsTaskOption<_FUNCTION_>::value, int>::type
+    AddTask(_FUNCTION_ func, _ARGS_... args)
     {
-        static thread_local CSocket client;
-        int ret = 0;
+        return Submit(TASK_NORMAL, nullptr, CTaskFunction(func, args...));
+    }
+
+    // ָȼͶ
+    template<typename _FUNCTION_, typename... _ARGS_>
+    typename std::enable_if<!IsTaskOption<_FUNCTION_>::value, int>::type
+    AddTask(TaskPriority priority, _FUNCTION_ func, _ARGS_... args)
+    {
+        return Submit(priority, nullptr, CTaskFunction(func, args...));
+    }
 
-        if (client == -1) {
-            ret = client.Init(CSockParam(m_path, 0));
-            if (ret != 0) return -1;
+    // ʱ group CTaskFutureGet ȡֵҲǶõ CTaskGroupWait ϣ
+    // group ɵ÷Уȫ
+    template<typename _FUNCTION_, typename... _ARGS_>
+    int AddTask(CTaskGroup& group, _FUNCTION_ func, _ARGS_... args)
+    {
+        return Submit(TASK_NORMAL, &group, CTaskFunction(func, args...));
+    }
 
-            ret = client.Link();
-            if (ret != 0) return -2;
-        }
+    template<typename _FUNCTION_, typename... _ARGS_>
+    int AddTask(TaskPriority priority, CTaskGroup& group, _FUNCTION_ func, _ARGS_... args)
+    {
+        return Submit(priority, &group, CTaskFunction(func, args...));
+    }
+
+    // ͶݣÿԪ item һ func(args..., item)ȫӺֻ֪ͨһ
+    // ʵͶݵС䳤˵δз -1
+    template<typename _ITER_, typename _FUNCTION_, typename... _ARGS_>
+    int AddTasks(_ITER_ begin, _ITER_ end, _FUNCTION_ func, _ARGS_... args)
+    {
+        return SubmitRange(TASK_NORMAL, nullptr, begin, end, func, args...);
+    }
+
+    template<typename _ITER_, typename _FUNCTION_, typename... _ARGS_>
+    int AddTasks(CTaskGroup& group, _ITER_ begin, _ITER_ end, _FUNCTION_ func, _ARGS_... args)
+    {
+        return SubmitRange(TASK_NORMAL, &group, begin, end, func, args...);
+    }
 
-        CFunctionBase* base =
-            new CFunction<_FUNCTION_, _ARGS_...>(func, args...);
-        if (base == nullptr) return -3;
+    template<typename _ITER_, typename _FUNCTION_, typename... _ARGS_>
+    int AddTasks(TaskPriority priority, _ITER_ begin, _ITER_ end, _FUNCTION_ func, _ARGS_... args)
+    {
+        return SubmitRange(priority, nullptr, begin, end, func, args...);
+    }
 
-        Buffer data(sizeof(base));
-        memcpy(data.data(), &base, sizeof(base));
+    template<typename _ITER_, typename _FUNCTION_, typename... _ARGS_>
+    int AddTasks(TaskPriority priority, CTaskGroup& group, _ITER_ begin, _ITER_ end, _FUNCTION_ func, _ARGS_... args)
+    {
+        return SubmitRange(priority, &group, begin, end, func, args...);
+    }
 
-        ret = client.Send(data);
-        if (ret != 0) {
-            delete base;
-            return -4;
+    // ȴ group ɣڵһ 0 񷵻ֵ
+    // ڱصĹ߳ʱߵȱִж񣬲Ϊ̶߳ڵȶ
+    // ȡʱͿ߳һ˯ m_event ϣӻʱ
+    int Wait(CTaskGroup& group)
+    {
+        if (Current().pool != this) return group.Wait();
+        size_t index = Current().index;
+        Task* task = nullptr;
+        m_helpers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);//  Run ɺ m_helpers 
+        while (!group.Done()) {
+            if (Take(index, task)) {
+                Run(task);
+                continue;
+            }
+            int key = m_event.Prepare();
+            if (group.Done()) {
+                m_event.Cancel();
+                break;
+            }
+            if (Take(index, task)) {
+                m_event.Cancel();
+                Run(task);
+                continue;
+            }
+            m_event.Wait(key);
+        }
+        m_helpers.fetch_sub(1);
+        return group.Result();
+    }
+
+private:
+    // ̳߳ڵ㣺ִ + ѡ + ȼ
+    struct Task {
+        CTaskFunction func;
+        CTaskGroup* group = nullptr;
+        int priority = TASK_NORMAL;
+    };
+
+    // ȸִڵ㣬󶨶ڽڵȶкٷڴ
+    Task* Alloc(int priority, CTaskGroup* group, CTaskFunction&& func)
+    {
+        Task* task = nullptr;
+        if (!m_free.Pop(task)) {
+            task = new (std::nothrow) Task();
+            if (task == nullptr) return nullptr;
         }
+        task->func = std::move(func);
+        task->group = group;
+        task->priority = priority;
+        if (group) group->Add();
+        return task;
+    }
 
+    // ߳Ͷͨȼ񣺷ŽԼ˫˶У˻ȫֶ
+    bool Push(Task* task)
+    {
+        CWorkDeque<Task*>* local = (task->priority == TASK_NORMAL) ? Local() : nullptr;
+        if ((local == nullptr || !local->Push(task)) && !m_queues[task->priority].Push(task)) {// 
+            if (task->group && task->group->Cancel()) WakeHelpers();
+            Recycle(task);
+            return false;
+        }
+        return true;
+    }
+
+    int Submit(int priority, CTaskGroup* group, CTaskFunction&& func)
+    {
+        if (!m_running) return -1;
+        if (priority < 0 || priority >= TASK_PRIORITIES) return -2;
+        Task* task = Alloc(priority, group, std::move(func));
+        if (task == nullptr) return -3;
+        if (!Push(task)) return -4;
+        m_event.Notify();
         return 0;
     }
 
-private:
-    int TaskDispatch()
-    {
-        while (m_epoll != -1) {
-            EPEvents events;
-            ssize_t esize = m_epoll.WaitEvents(events);
-
-            if (esize > 0) {
-                for (ssize_t i = 0; i < esize; ++i) {
-                    if (events[i].events & EPOLLIN) {
-
-                        if (events[i].data.ptr == m_server) {
-                            // ¿ͻ
-                            CSocketBase* pClient = nullptr;
-                            int ret = m_server->Link(&pClient);
-                            if (ret != 0) continue;
-
-                            ret = m_epoll.Add(*pClient,
-                                EpollData((void*)pClient));
-                            if (ret != 0) {
-                                delete pClient;
-                                continue;
-                            }
-                        }
-                        else {// ͻ˷
-                            CSocketBase* pClient =
-                                (CSocketBase*)events[i].data.ptr;
-
-                            if (!pClient) continue;
-
-                            CFunctionBase* base = nullptr;
-                            Buffer data(sizeof(base));
-
-                            int ret = pClient->Recv(data);
-                            if (ret <= 0) {
-                                m_epoll.Del(*pClient);
-                                delete pClient;
-                                continue;
-                            }
-
-                            memcpy(&base, (char*)data, sizeof(base));
-                            if (base != nullptr) {
-                                (*base)();
-                                delete base;
-                            }
-                        }
-                    }
+    template<typename _ITER_, typename _FUNCTION_, typename... _ARGS_>
+    int SubmitRange(int priority, CTaskGroup* group, _ITER_ begin, _ITER_ end, _FUNCTION_ func, _ARGS_... args)
+    {
+        if (!m_running) return -1;
+        if (priority < 0 || priority >= TASK_PRIORITIES) return -2;
+        int count = 0;
+        for (; begin != end; ++begin) {
+            Task* task = Alloc(priority, group, CTaskFunction(func, args..., *begin));
+            if (task == nullptr || !Push(task)) break;
+            count++;
+        }
+        if (count > 0) m_event.Notify(count);// һ futex  count ߳
+        return count;
+    }
+
+    void Run(Task* task)
+    {
+        int priority = task->priority;
+        int ret = task->func();
+        bool done = (task->group != nullptr) && task->group->Finish(ret);
+        Recycle(task);
+        if (done) WakeHelpers();
+        if (m_limits[priority] > 0) {
+            m_busy[priority]--;
+            // ߳Ϊһ˯£߳ Wait æִУδػٻȡһ
+            m_event.Notify();
+        }
+    }
+
+    // ɣ Wait ˯ŵḶ́߳ԼԼȵ
+    void WakeHelpers()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);//  Wait Ǽ m_helpers ֮
+        if (m_helpers.load() > 0) m_event.NotifyAll();
+    }
+
+    void Drop(Task* task)
+    {
+        if (task->group) task->group->Finish(-1);
+        delete task;
+    }
+
+    // ǰ߳ǱصḶ́߳ȡģʽ˫˶
+    CWorkDeque<Task*>* Local()
+    {
+        if (m_scheduler != POOL_STEALING || Current().pool != this) return nullptr;
+        return m_deques[Current().index];
+    }
+
+    struct Worker {
+        CThreadPool* pool = nullptr;
+        size_t index = 0;
+        unsigned seed = 0; // ѡȡ xorshift ״̬
+        int credits[TASK_PRIORITIES] = {}; // Ȩתĵǰֵ
+    };
+    static Worker& Current()
+    {
+        static thread_local Worker worker;
+        return worker;
+    }
+
+    // ȼ˳𼶳ԣļ
+    bool Take(size_t index, Task*& task)
+    {
+        int order[TASK_PRIORITIES];
+        Order(order);
+        for (int i = 0; i < TASK_PRIORITIES; i++) {
+            int priority = order[i];
+            if (!Reserve(priority)) continue;
+            if (TakeFrom(index, priority, task)) return true;
+            if (m_limits[priority] > 0) m_busy[priority]--;
+        }
+        return false;
+    }
+
+    // ȲһϸģʽȼȨģʽƽȨתѡһ԰ȼں
+    void Order(int order[TASK_PRIORITIES])
+    {
+        int first = 0;
+        if (m_weighted) {
+            int* credits = Current().credits;
+            int total = 0;
+            for (int i = 0; i < TASK_PRIORITIES; i++) {
+                credits[i] += m_weights[i];
+                total += m_weights[i];
+                if (credits[i] > credits[first]) first = i;
+            }
+            credits[first] -= total;
+        }
+        int n = 0;
+        order[n++] = first;
+        for (int i = 0; i < TASK_PRIORITIES; i++) {
+            if (i != first) order[n++] = i;
+        }
+    }
+
+    // ռһִΪ 0 ʱ
+    bool Reserve(int priority)
+    {
+        if (m_limits[priority] == 0) return true;
+        if (m_busy[priority].fetch_add(1) < (int)m_limits[priority]) return true;
+        m_busy[priority]--;
+        return false;
+    }
+
+    // ͨȼγԣԼĶ -> ȫֶ -> ̵߳ĶУȼֻȫֶ
+    bool TakeFrom(size_t index, int priority, Task*& task)
+    {
+        if (m_scheduler != POOL_STEALING || priority != TASK_NORMAL) return m_queues[priority].Pop(task);
+        if (m_deques[index]->Pop(task)) return true;
+        if (m_queues[priority].Pop(task)) return true;
+        size_t count = m_deques.size();
+        unsigned& seed = Current().seed;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        size_t start = seed % count;
+        for (size_t i = 0; i < count; i++) {
+            size_t victim = (start + i) % count;
+            if (victim != index && m_deques[victim]->Steal(task)) return true;
+        }
+        return false;
+    }
+
+    // ִ󶨵ĲڵŻؿ˲ͷ
+    void Recycle(Task* task)
+    {
+        task->func.Reset();
+        task->group = nullptr;
+        if (!m_free.Push(task)) delete task;
+    }
+
+    int TaskDispatch(size_t index)
+    {
+        Worker& self = Current();
+        self.pool = this;
+        self.index = index;
+        self.seed = (unsigned)(index * 2654435761u) | 1;
+        Task* task = nullptr;
+        while (m_running) {
+            if (!Take(index, task)) {
+                // ȵǼǿٲһΣAddTask ֮Ҳ©
+                int key = m_event.Prepare();
+                if (!Take(index, task)) {
+                    if (m_running) m_event.Wait(key);
+                    else m_event.Cancel();
+                    continue;
                 }
+                m_event.Cancel();
             }
+            Run(task);
         }
+        self.pool = nullptr;
         return 0;
     }
 
 private:
-	CEpoll m_epoll;         // Epoll ʵ
     std::vector<CThread*> m_threads;
-    CSocketBase* m_server;  // շ
-    Buffer m_path;          //  Socket ļ·
-};
\ No newline at end of file
+    CMpmcQueue<Task*> m_queues[TASK_PRIORITIES]; // ȼĴִ񣨹ȡģʽͨȼֻⲿ߳Ͷݵ
+    std::vector<CWorkDeque<Task*>*> m_deques; // ȡģʽÿ̵߳˫˶
+    CMpmcQueue<Task*> m_free;  // ִɸõڵ
+    CEventCount m_event;                // ̵߳˯뻽
+    std::atomic<bool> m_running;
+    std::atomic<int> m_helpers;         //  Wait ߵȱִеĹ߳
+    int m_scheduler;                    // PoolScheduler
+    bool m_weighted;                    // ǷȨת
+    unsigned m_weights[TASK_PRIORITIES];
+    unsigned m_limits[TASK_PRIORITIES];
+    std::atomic<int> m_busy[TASK_PRIORITIES]; // ȼִеֻͳ޵ļ
+};
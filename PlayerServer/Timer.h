@@ -0,0 +1,150 @@
+#pragma once
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+#define TIMER_TICK_MS 100   //时间轮刻度（毫秒）
+#define TIMER_SLOTS 512     //时间轮槽数，转一圈 51.2 秒，更长的超时靠圈数
+
+//定时器节点，嵌入到使用者的对象中（侵入式链表），调度与取消都不分配内存
+class CTimerNode {
+public:
+    CTimerNode() : data(nullptr), prev(nullptr), next(nullptr), rounds(0), slot(-1), kind(0) {}
+    bool Active() const { return slot >= 0; }
+    //Schedule 时登记的定时器类型，只在持锁的回调（Expire/ForEach）里读取才可靠
+    unsigned Kind() const { return kind; }
+
+public:
+    void* data; //使用者自定义数据，通常指回宿主对象
+
+private:
+    friend class CTimingWheel;
+    CTimerNode* prev;
+    CTimerNode* next;
+    unsigned rounds; //还需转过的圈数
+    int slot;        //所在槽位，-1 表示未调度
+    unsigned kind;   //使用者自定义的类型
+};
+
+//哈希时间轮：Schedule / Cancel 均为 O(1)
+//由 timerfd 驱动，把 operator int() 得到的 fd 加入 epoll，可读时调用 Expire
+//内部有锁：同一个轮子可以被多个线程调度，Expire 在持锁状态下调用回调
+class CTimingWheel {
+public:
+    CTimingWheel() : m_timer(-1), m_current(0) {}
+    ~CTimingWheel() { Close(); }
+    CTimingWheel(const CTimingWheel&) = delete;
+    CTimingWheel& operator=(const CTimingWheel&) = delete;
+
+    operator int() const { return m_timer; }
+
+public:
+    int Init() {
+        if (m_timer != -1) return -1;
+        m_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (m_timer == -1) return -2;
+        itimerspec spec;
+        spec.it_interval.tv_sec = TIMER_TICK_MS / 1000;
+        spec.it_interval.tv_nsec = (TIMER_TICK_MS % 1000) * 1000000L;
+        spec.it_value = spec.it_interval;
+        if (timerfd_settime(m_timer, 0, &spec, nullptr) == -1) {
+            Close();
+            return -3;
+        }
+        m_slots.assign(TIMER_SLOTS, nullptr);
+        return 0;
+    }
+
+    //在 ms 毫秒后到期；已调度的节点会先被取消（即重置超时）
+    //kind 由使用者定义，用来在 ForEach 中区分定时器的用途
+    void Schedule(CTimerNode* node, unsigned ms, unsigned kind = 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Unlink(node);
+        node->kind = kind;
+        unsigned ticks = (ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+        if (ticks == 0) ticks = 1;
+        node->rounds = (ticks - 1) / TIMER_SLOTS;
+        node->slot = (int)((m_current + ticks) % TIMER_SLOTS);
+        node->prev = nullptr;
+        node->next = m_slots[node->slot];
+        if (node->next) node->next->prev = node;
+        m_slots[node->slot] = node;
+    }
+
+    void Cancel(CTimerNode* node) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Unlink(node);
+    }
+
+    //timerfd 可读时调用：按实际经过的刻度推进，对每个到期节点调用 func(node)
+    //节点在回调前已摘下；回调在持锁状态下执行，不能再调用本对象的 Schedule / Cancel
+    //返回值：>=0 到期的节点数；<0 错误
+    template <typename _FUNCTION_>
+    int Expire(_FUNCTION_ func) {
+        uint64_t ticks = 0;
+        ssize_t len = read(m_timer, &ticks, sizeof(ticks));
+        if (len != sizeof(ticks)) {
+            if (len < 0 && (errno == EAGAIN || errno == EINTR)) return 0;//其他线程已取走
+            return -1;
+        }
+        int count = 0;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (ticks > TIMER_SLOTS) ticks = TIMER_SLOTS;//长时间未处理，至多扫一圈
+        for (uint64_t t = 0; t < ticks; t++) {
+            m_current = (m_current + 1) % TIMER_SLOTS;
+            CTimerNode* node = m_slots[m_current];
+            while (node) {
+                CTimerNode* next = node->next;
+                if (node->rounds > 0) {
+                    node->rounds--;
+                }
+                else {
+                    Unlink(node);
+                    func(node);
+                    count++;
+                }
+                node = next;
+            }
+        }
+        return count;
+    }
+
+    //持锁遍历所有已调度的节点，不推进时间；约束同 Expire
+    //持锁期间已调度的节点不会被 Cancel，使用者可据此保证宿主对象仍然有效
+    template <typename _FUNCTION_>
+    void ForEach(_FUNCTION_ func) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (CTimerNode* head : m_slots) {
+            for (CTimerNode* node = head; node != nullptr; node = node->next) {
+                func(node);
+            }
+        }
+    }
+
+    void Close() {
+        if (m_timer != -1) {
+            int fd = m_timer;
+            m_timer = -1;
+            ::close(fd);
+        }
+    }
+
+private:
+    void Unlink(CTimerNode* node) {
+        if (node->slot < 0) return;
+        if (node->prev) node->prev->next = node->next;
+        else m_slots[node->slot] = node->next;
+        if (node->next) node->next->prev = node->prev;
+        node->prev = node->next = nullptr;
+        node->slot = -1;
+    }
+
+private:
+    int m_timer;                       //timerfd
+    unsigned m_current;                //当前刻度所在槽
+    std::vector<CTimerNode*> m_slots;  //每个槽一条双向链表
+    std::mutex m_mutex;
+};
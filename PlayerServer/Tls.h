@@ -0,0 +1,283 @@
+#pragma once
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/rand.h>
+#include <stdio.h>
+#include "Socket.h"
+
+#define TLS_SESSION_CACHE 20480 //单进程会话缓存条数（TLS 1.2 session id 复用）
+#define TLS_SESSION_TIMEOUT 7200 //会话/票据有效期（秒）
+#define TLS_TICKET_KEY_SIZE 80  //票据密钥文件长度：OpenSSL 3 为 16 字节名 + 32 字节 HMAC 密钥 + 32 字节 AES 密钥
+
+//TLS 参数：cert 为空表示不启用 TLS
+class CTlsParam {
+public:
+    CTlsParam() : cachesize(TLS_SESSION_CACHE), timeout(TLS_SESSION_TIMEOUT), ktls(false) {}
+
+public:
+    Buffer cert;        // 证书链文件（PEM）；握手开销主要在签名，ECDSA 证书比 RSA 便宜得多
+    Buffer key;         // 私钥文件（PEM）
+    Buffer ticketkey;   // 会话票据密钥文件（TLS_TICKET_KEY_SIZE 字节），多台机器/重启之间共用；空则启动时随机生成
+    unsigned cachesize; // 会话缓存条数，0 表示不缓存
+    unsigned timeout;   // 会话/票据有效期（秒）
+    bool ktls;          // 握手后把对称加密交给内核（TCP_ULP "tls"），之后可用 SendFile 零拷贝发送
+};
+
+/*
+* 进程共享的 SSL_CTX：证书、会话缓存与票据密钥
+* 必须在 fork 业务子进程之前 Init：子进程继承同一组票据密钥，客户端重连落到任何一个子进程都能用票据恢复会话，
+* 跳过证书签名和密钥交换；session id 缓存只在进程内有效，作为不支持票据的客户端的补充
+*/
+class CTlsContext {
+public:
+    CTlsContext() : m_ctx(nullptr) {}
+    ~CTlsContext() { Close(); }
+    CTlsContext(const CTlsContext&) = delete;
+    CTlsContext& operator=(const CTlsContext&) = delete;
+
+    operator SSL_CTX* () const { return m_ctx; }
+
+public:
+    int Init(const CTlsParam& param) {
+        if (m_ctx != nullptr) return -1;
+        m_ctx = SSL_CTX_new(TLS_server_method());
+        if (m_ctx == nullptr) return -2;
+        SSL_CTX_set_min_proto_version(m_ctx, TLS1_2_VERSION);
+        //非阻塞 Send 遇到 WANT_WRITE 时剩余数据进队列，重试时 Buffer 地址会变
+        SSL_CTX_set_mode(m_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+        if (SSL_CTX_use_certificate_chain_file(m_ctx, param.cert) != 1) return Fail(-3);
+        if (SSL_CTX_use_PrivateKey_file(m_ctx, param.key, SSL_FILETYPE_PEM) != 1) return Fail(-4);
+        if (SSL_CTX_check_private_key(m_ctx) != 1) return Fail(-5);
+        //会话复用：session id 缓存 + 无状态票据
+        static const unsigned char sid[] = "PlayerServer";
+        SSL_CTX_set_session_id_context(m_ctx, sid, sizeof(sid) - 1);
+        SSL_CTX_set_session_cache_mode(m_ctx, (param.cachesize > 0) ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_OFF);
+        SSL_CTX_sess_set_cache_size(m_ctx, param.cachesize);
+        SSL_CTX_set_timeout(m_ctx, param.timeout);
+        int ret = SetTicketKey(param.ticketkey);
+        if (ret != 0) return Fail(ret);
+        if (param.ktls) {
+#ifdef SSL_OP_ENABLE_KTLS
+            //OpenSSL 在握手完成后自行 setsockopt(TCP_ULP, "tls") 并下发密钥；内核或套件不支持时照常走用户态加密
+            SSL_CTX_set_options(m_ctx, SSL_OP_ENABLE_KTLS);
+#else
+            return Fail(-8);
+#endif
+        }
+        return 0;
+    }
+
+    void Close() {
+        if (m_ctx) {
+            SSL_CTX_free(m_ctx);
+            m_ctx = nullptr;
+        }
+    }
+
+private:
+    //票据密钥：指定文件时读入，保证多台机器/重启后发出的票据仍可用；否则在此随机生成，fork 后各子进程相同
+    int SetTicketKey(const Buffer& path) {
+        unsigned char key[TLS_TICKET_KEY_SIZE];
+        if (path.size() > 0) {
+            FILE* file = fopen(path, "rb");
+            if (file == nullptr) return -6;
+            size_t len = fread(key, 1, sizeof(key), file);
+            fclose(file);
+            if (len != sizeof(key)) return -6;
+        }
+        else if (RAND_bytes(key, sizeof(key)) != 1) return -7;
+        int ret = SSL_CTX_set_tlsext_ticket_keys(m_ctx, key, sizeof(key));
+        OPENSSL_cleanse(key, sizeof(key));
+        return (ret == 1) ? 0 : -7;
+    }
+
+    int Fail(int ret) {
+        ERR_clear_error();
+        Close();
+        return ret;
+    }
+
+private:
+    SSL_CTX* m_ctx;
+};
+
+/*
+* TLS 连接：fd 由 accept/父进程移交得来，握手在第一次 RecvAppend 时以非阻塞方式进行
+* 握手需要写而内核缓冲已满时 Pending 返回 1，调用方照常等 EPOLLOUT 后 Flush 继续握手
+* 发送队列沿用 CSocket 的：SSL_write 遇到 WANT_WRITE 时剩余部分排队，重试时原样从队首继续
+*/
+class CTlsSocket : public CSocket {
+public:
+    CTlsSocket(int sock, SSL_CTX* ctx) : CSocket(sock), m_ssl(nullptr), m_ctx(ctx),
+        m_handshaked(false), m_wantwrite(false), m_ktls(false) {}
+    virtual ~CTlsSocket() { Close(); }
+
+public:
+    virtual int Init(const CSockParam& param) {
+        int ret = CSocket::Init(param);
+        if (ret != 0) return ret;
+        m_ssl = SSL_new(m_ctx);
+        if (m_ssl == nullptr) return -10;
+        if (SSL_set_fd(m_ssl, m_socket) != 1) return -11;
+        SSL_set_accept_state(m_ssl);
+        return 0;
+    }
+
+    virtual int Send(const Buffer& data) {
+        if (m_status < 2 || (m_ssl == nullptr)) return -1;
+        size_t index = 0;
+        if ((m_outsize == 0) && m_handshaked) {
+            while (index < data.size()) {
+                size_t len = 0;
+                int ret = SSL_write_ex(m_ssl, (const char*)data + index, data.size() - index, &len);
+                if (ret == 1) {
+                    index += len;
+                    continue;
+                }
+                int err = SSL_get_error(m_ssl, ret);
+                if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) break;
+                return -3;
+            }
+            if (index == data.size()) return 0;
+        }
+        //握手未完成或已有积压：排在后面，握手完成后由 Flush 写出
+        size_t rest = data.size() - index;
+        if (m_outsize + rest > m_highwater) return -4;
+        m_outq.emplace_back((const char*)data + index, rest);
+        m_outsize += rest;
+        return 1;
+    }
+
+    virtual int Flush() {
+        if (m_status < 2 || (m_ssl == nullptr)) return -1;
+        if (!m_handshaked) {
+            int ret = Handshake();
+            if (ret < 0) return ret;
+            if (!m_handshaked) return (int)Pending();
+        }
+        while (m_outsize > 0) {//逐个 Buffer 写：重试 SSL_write 必须从上次失败的同一位置、同样长度开始
+            const Buffer& front = m_outq.front();
+            size_t len = 0;
+            int ret = SSL_write_ex(m_ssl, (const char*)front + m_outoffset, front.size() - m_outoffset, &len);
+            if (ret != 1) {
+                int err = SSL_get_error(m_ssl, ret);
+                if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) break;
+                return -3;
+            }
+            m_outsize -= len;
+            m_outoffset += len;
+            if (m_outoffset == front.size()) {
+                m_outq.pop_front();
+                m_outoffset = 0;
+            }
+        }
+        return (int)m_outsize;
+    }
+
+    virtual size_t Pending() const {
+        if (m_wantwrite) return m_outsize + 1;//握手数据没写完：让调用方等 EPOLLOUT
+        return m_handshaked ? m_outsize : 0;//握手期间排队的响应不算积压，不阻止继续读握手数据
+    }
+
+    //启用 kTLS 时由内核加密，文件页直接进套接字；否则读出后经 SSL_write 发送
+    virtual ssize_t SendFile(int fd, off_t* offset, size_t count) {
+        if (m_status < 2 || (m_ssl == nullptr) || !m_handshaked || (m_outsize > 0)) return -1;
+#ifdef SSL_OP_ENABLE_KTLS
+        if (m_ktls) {
+            ossl_ssize_t len = SSL_sendfile(m_ssl, fd, *offset, count, 0);
+            if (len >= 0) {
+                *offset += len;
+                return len;
+            }
+            int err = SSL_get_error(m_ssl, (int)len);
+            if (err == SSL_ERROR_WANT_WRITE) return 0;
+            return -3;
+        }
+#endif
+        char buf[16 * 1024];
+        ssize_t size = pread(fd, buf, (count < sizeof(buf)) ? count : sizeof(buf), *offset);
+        if (size <= 0) return (size == 0) ? 0 : -2;
+        size_t len = 0;
+        int ret = SSL_write_ex(m_ssl, buf, (size_t)size, &len);
+        if (ret != 1) {//未写出的部分下次从同一 offset 重新读出，内容与长度不变
+            int err = SSL_get_error(m_ssl, ret);
+            if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) return 0;
+            return -3;
+        }
+        *offset += len;
+        return (ssize_t)len;
+    }
+
+    // 握手完成前返回 0（等下一次可读）；之后与 CSocket 相同：>0 字节数；0 EAGAIN；-2 错误；-3 对端关闭
+    virtual int RecvAppend(Buffer& data, size_t chunk = 4096) {
+        if (m_status < 2 || (m_ssl == nullptr)) return -1;
+        if (!m_handshaked) {
+            int ret = Handshake();
+            if (ret < 0) return ret;
+            if (!m_handshaked) return 0;
+            if (Flush() < 0) return -2;//握手期间排队的数据
+        }
+        size_t size = data.size();
+        size_t len = 0;
+        int ret = SSL_read_ex(m_ssl, data.writable_tail(chunk), chunk, &len);
+        if (ret == 1) {
+            data.resize(size + len);
+            return (int)len;
+        }
+        data.resize(size);
+        int err = SSL_get_error(m_ssl, ret);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) return 0;
+        if (err == SSL_ERROR_ZERO_RETURN) return -3;//close_notify
+        if (err == SSL_ERROR_SYSCALL && errno == 0) return -3;//未发 close_notify 直接断开
+        ERR_clear_error();
+        return -2;
+    }
+
+    // 读入预分配的 data.size() 字节，返回值同 RecvAppend
+    virtual int Recv(Buffer& data) {
+        size_t size = data.size();
+        data.resize(0);
+        return RecvAppend(data, size);
+    }
+
+    virtual int Close() {
+        if (m_ssl) {
+            if (m_handshaked) SSL_shutdown(m_ssl);//只发 close_notify，不等对端回应
+            SSL_free(m_ssl);
+            m_ssl = nullptr;
+        }
+        ERR_clear_error();
+        return CSocket::Close();
+    }
+
+    bool Ktls() const { return m_ktls; }
+
+private:
+    //0 已完成或仍需等待；<0 握手失败
+    int Handshake() {
+        m_wantwrite = false;
+        int ret = SSL_do_handshake(m_ssl);
+        if (ret == 1) {
+            m_handshaked = true;
+#ifdef SSL_OP_ENABLE_KTLS
+            m_ktls = (BIO_get_ktls_send(SSL_get_wbio(m_ssl)) != 0);
+#endif
+            return 0;
+        }
+        int err = SSL_get_error(m_ssl, ret);
+        if (err == SSL_ERROR_WANT_READ) return 0;
+        if (err == SSL_ERROR_WANT_WRITE) {
+            m_wantwrite = true;
+            return 0;
+        }
+        ERR_clear_error();
+        return -12;
+    }
+
+private:
+    SSL* m_ssl;
+    SSL_CTX* m_ctx;
+    bool m_handshaked; // 握手已完成
+    bool m_wantwrite;  // 握手卡在写上
+    bool m_ktls;       // 发送方向已由内核加密
+};
@@ -0,0 +1,325 @@
+#pragma once
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <errno.h>
+#include <deque>
+#include <vector>
+#include "Socket.h"
+
+#define URING_ENTRIES 256      //SQ 深度，CQ 为其两倍
+#define URING_BUFFERS 256      //提供给内核的接收缓冲个数（须为 2 的幂）
+#define URING_BUFFER_SIZE 4096 //每个接收缓冲的大小
+#define URING_BGID 0           //接收缓冲组号
+#define URING_SEND_CHAIN 16    //一条链接发送链上最多的 Buffer 数
+
+/*
+* io_uring 的薄封装，接口风格与 CEpoll 一致，直接使用系统调用，不依赖 liburing
+* 一个 CUring 只能由一个线程提交和收割（SQ/CQ 都是单生产者/单消费者）
+* 典型用法：GetSqe + Prep* 填写若干请求 -> Submit(1) 一次系统调用提交并等待 -> Reap 处理完成事件
+*/
+class CUring {
+public:
+    CUring() : m_fd(-1), m_ring(nullptr), m_ringSize(0), m_cqRing(nullptr), m_cqSize(0),
+        m_sqes(nullptr), m_sqeSize(0), m_sqtail(0), m_submitted(0),
+        m_bufRing(nullptr), m_bufRingSize(0), m_buffers(nullptr), m_bufCount(0), m_bufSize(0), m_bufTail(0) {
+        memset(&m_params, 0, sizeof(m_params));
+    }
+    ~CUring() { Close(); }
+    CUring(const CUring&) = delete;
+    CUring& operator=(const CUring&) = delete;
+
+    operator int() const { return m_fd; }
+
+public:
+    int Init(unsigned entries = URING_ENTRIES) {
+        if (m_fd != -1) return -1;
+        memset(&m_params, 0, sizeof(m_params));
+        //COOP_TASKRUN：完成事件只在本线程进入内核时处理，不用 IPI 打断；老内核不支持时退回默认
+        m_params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+        m_fd = (int)syscall(__NR_io_uring_setup, entries, &m_params);
+        if (m_fd == -1 && errno == EINVAL) {
+            memset(&m_params, 0, sizeof(m_params));
+            m_fd = (int)syscall(__NR_io_uring_setup, entries, &m_params);
+        }
+        if (m_fd == -1) return -2;
+
+        m_ringSize = m_params.sq_off.array + m_params.sq_entries * sizeof(unsigned);
+        m_cqSize = m_params.cq_off.cqes + m_params.cq_entries * sizeof(io_uring_cqe);
+        if (m_params.features & IORING_FEAT_SINGLE_MMAP) {
+            if (m_cqSize > m_ringSize) m_ringSize = m_cqSize;
+        }
+        m_ring = mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (m_ring == MAP_FAILED) { m_ring = nullptr; Close(); return -3; }
+        if (m_params.features & IORING_FEAT_SINGLE_MMAP) {
+            m_cqRing = m_ring;
+        }
+        else {
+            m_cqRing = mmap(nullptr, m_cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+            if (m_cqRing == MAP_FAILED) { m_cqRing = nullptr; Close(); return -4; }
+        }
+        m_sqeSize = m_params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = (io_uring_sqe*)mmap(nullptr, m_sqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (m_sqes == MAP_FAILED) { m_sqes = nullptr; Close(); return -5; }
+
+        char* sq = (char*)m_ring;
+        char* cq = (char*)m_cqRing;
+        m_sqHead = (unsigned*)(sq + m_params.sq_off.head);
+        m_sqTail = (unsigned*)(sq + m_params.sq_off.tail);
+        m_sqMask = *(unsigned*)(sq + m_params.sq_off.ring_mask);
+        m_cqHead = (unsigned*)(cq + m_params.cq_off.head);
+        m_cqTail = (unsigned*)(cq + m_params.cq_off.tail);
+        m_cqMask = *(unsigned*)(cq + m_params.cq_off.ring_mask);
+        m_cqes = (io_uring_cqe*)(cq + m_params.cq_off.cqes);
+        //SQ 下标数组固定为恒等映射，第 i 个 SQE 就是 m_sqes[i & mask]
+        unsigned* array = (unsigned*)(sq + m_params.sq_off.array);
+        for (unsigned i = 0; i < m_params.sq_entries; i++) array[i] = i;
+        m_sqtail = m_submitted = *m_sqTail;
+        return 0;
+    }
+
+    //注册一组由内核挑选的接收缓冲（provided buffer ring），供多发 recv 使用
+    int SetupBuffers(unsigned count = URING_BUFFERS, unsigned size = URING_BUFFER_SIZE) {
+        if (m_fd == -1 || m_bufRing != nullptr) return -1;
+        if (count == 0 || (count & (count - 1)) != 0) return -2;
+        m_bufRingSize = count * sizeof(io_uring_buf);
+        void* ring = mmap(nullptr, m_bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED) return -3;
+        memset(ring, 0, m_bufRingSize);
+        m_bufRing = (io_uring_buf_ring*)ring;
+        m_buffers = new char[(size_t)count * size];
+        m_bufCount = count;
+        m_bufSize = size;
+
+        io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = (uint64_t)(uintptr_t)m_bufRing;
+        reg.ring_entries = count;
+        reg.bgid = URING_BGID;
+        if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) return -4;
+
+        m_bufTail = 0;
+        for (unsigned i = 0; i < count; i++) RecycleBuffer((uint16_t)i);
+        return 0;
+    }
+
+    char* BufferAddr(uint16_t bid) const { return m_buffers + (size_t)bid * m_bufSize; }
+
+    //把内核用过的接收缓冲还回去
+    void RecycleBuffer(uint16_t bid) {
+        //不用 m_bufRing->bufs：__DECLARE_FLEX_ARRAY 在 C++ 下多出一个空结构体，偏移不对
+        io_uring_buf* buf = (io_uring_buf*)m_bufRing + (m_bufTail & (m_bufCount - 1));
+        buf->addr = (uint64_t)(uintptr_t)BufferAddr(bid);
+        buf->len = m_bufSize;
+        buf->bid = bid;
+        m_bufTail++;
+        __atomic_store_n(&m_bufRing->tail, m_bufTail, __ATOMIC_RELEASE);
+    }
+
+    //取一个空闲的 SQE；SQ 已满时返回 nullptr，调用方先 Submit(0) 再取
+    io_uring_sqe* GetSqe() {
+        unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        if (m_sqtail - head >= m_params.sq_entries) return nullptr;
+        io_uring_sqe* sqe = &m_sqes[m_sqtail & m_sqMask];
+        m_sqtail++;
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    //SQ 剩余空位
+    unsigned Space() const {
+        return m_params.sq_entries - (m_sqtail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE));
+    }
+
+    //提交所有已填写的 SQE，并至少等到 wait 个完成事件
+    //返回值：>=0 本次提交的个数；<0 错误（-EINTR 表示被信号打断，可直接重试）
+    int Submit(unsigned wait = 0) {
+        if (m_fd == -1) return -EBADF;
+        __atomic_store_n(m_sqTail, m_sqtail, __ATOMIC_RELEASE);
+        unsigned count = m_sqtail - m_submitted;
+        if (count == 0 && wait == 0) return 0;
+        unsigned flags = (wait > 0) ? IORING_ENTER_GETEVENTS : 0;
+        int ret = (int)syscall(__NR_io_uring_enter, m_fd, count, wait, flags, nullptr, 0);
+        if (ret < 0) return -errno;
+        m_submitted += ret;
+        return ret;
+    }
+
+    //处理所有已完成的 CQE，返回处理的个数；func 中可以继续 GetSqe
+    template <typename _FUNCTION_>
+    unsigned Reap(_FUNCTION_ func) {
+        unsigned head = *m_cqHead;
+        unsigned count = 0;
+        while (head != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+            io_uring_cqe cqe = m_cqes[head & m_cqMask];
+            head++;
+            __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);//先归还槽位，回调里产生的完成事件不会覆盖
+            func(&cqe);
+            count++;
+        }
+        return count;
+    }
+
+    void Close() {
+        if (m_sqes) { munmap(m_sqes, m_sqeSize); m_sqes = nullptr; }
+        if (m_cqRing && m_cqRing != m_ring) munmap(m_cqRing, m_cqSize);
+        m_cqRing = nullptr;
+        if (m_ring) { munmap(m_ring, m_ringSize); m_ring = nullptr; }
+        if (m_fd != -1) {
+            int fd = m_fd;
+            m_fd = -1;
+            ::close(fd);
+        }
+        //缓冲在 ring 关闭（内核注销）之后才能释放
+        if (m_bufRing) { munmap(m_bufRing, m_bufRingSize); m_bufRing = nullptr; }
+        if (m_buffers) { delete[] m_buffers; m_buffers = nullptr; }
+    }
+
+public:
+    //多发 accept：一次提交，之后每个新连接都产生一个 CQE（res 为新 fd）
+    static void PrepAccept(io_uring_sqe* sqe, int fd, uint64_t user) {
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = user;
+    }
+
+    //多发 recv：数据写入内核挑选的缓冲，缓冲号在 cqe->flags >> IORING_CQE_BUFFER_SHIFT
+    static void PrepRecv(io_uring_sqe* sqe, int fd, uint64_t user) {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = URING_BGID;
+        sqe->user_data = user;
+    }
+
+    //send；link 为 true 时与下一个 SQE 链接，按顺序执行，前一个失败则后续取消
+    static void PrepSend(io_uring_sqe* sqe, int fd, const void* data, size_t size, uint64_t user, bool link) {
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)data;
+        sqe->len = (unsigned)size;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL; //WAITALL：短写由内核继续重试，保证链上的顺序
+        sqe->flags = link ? IOSQE_IO_LINK : 0;
+        sqe->user_data = user;
+    }
+
+    //取消 user_data 为 target 的在途请求（如多发 accept），被取消的请求返回 -ECANCELED
+    static void PrepCancel(io_uring_sqe* sqe, uint64_t target, uint64_t user) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = target;
+        sqe->user_data = user;
+    }
+
+    //多发 poll：用于 eventfd / timerfd 这类需要自己 read 的 fd
+    static void PrepPoll(io_uring_sqe* sqe, int fd, uint64_t user) {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = POLLIN;
+        sqe->len = IORING_POLL_ADD_MULTI;
+        sqe->user_data = user;
+    }
+
+private:
+    int m_fd;
+    io_uring_params m_params;
+    void* m_ring;
+    size_t m_ringSize;
+    void* m_cqRing;
+    size_t m_cqSize;
+    io_uring_sqe* m_sqes;
+    size_t m_sqeSize;
+    unsigned* m_sqHead;
+    unsigned* m_sqTail;
+    unsigned m_sqMask;
+    unsigned* m_cqHead;
+    unsigned* m_cqTail;
+    unsigned m_cqMask;
+    io_uring_cqe* m_cqes;
+    unsigned m_sqtail;     //本地 SQ 尾（已填写）
+    unsigned m_submitted;  //已提交给内核的位置
+    io_uring_buf_ring* m_bufRing;
+    size_t m_bufRingSize;
+    char* m_buffers;
+    unsigned m_bufCount;
+    unsigned m_bufSize;
+    uint16_t m_bufTail;
+};
+
+//io_uring 模式下的连接套接字
+//Send 只排队不写，由所属循环把排队的数据以链接的 IORING_OP_SEND 提交；
+//在途数据在对应 CQE 返回之前保持有效
+class CUringSocket : public CSocket {
+public:
+    CUringSocket() : CSocket(), m_queued(0), m_inflight(0) {}
+    CUringSocket(int sock) : CSocket(sock), m_queued(0), m_inflight(0) {}
+    virtual ~CUringSocket() {}
+
+public:
+    //0 空数据；1 已排队；-1 未连接；-4 超过高水位
+    virtual int Send(const Buffer& data) {
+        if (m_status < 2 || (m_socket == -1)) return -1;
+        if (data.size() == 0) return 0;
+        if (m_queued + m_inflight + data.size() > m_highwater) return -4;
+        m_queue.push_back(data);
+        m_queued += data.size();
+        return 1;
+    }
+
+    virtual int Flush() { return (int)Pending(); }
+    virtual size_t Pending() const { return m_queued + m_inflight; }
+
+    //在途数据全部确认后，把至多 max 个排队 Buffer 转为在途，返回转移的个数
+    //deque 两端增删不会使其他元素的引用失效，提交出去的指针在完成前一直有效
+    size_t Prepare(size_t max = URING_SEND_CHAIN) {
+        if (!m_sending.empty()) return 0;
+        size_t count = 0;
+        while (!m_queue.empty() && count < max) {
+            m_inflight += m_queue.front().size();
+            m_queued -= m_queue.front().size();
+            m_sending.push_back(std::move(m_queue.front()));
+            m_queue.pop_front();
+            count++;
+        }
+        return count;
+    }
+    //Prepare 转出的 Buffer 未能提交：原样放回队首，顺序不变
+    void Requeue() {
+        while (!m_sending.empty()) {
+            m_inflight -= m_sending.back().size();
+            m_queued += m_sending.back().size();
+            m_queue.push_front(std::move(m_sending.back()));
+            m_sending.pop_back();
+        }
+    }
+    const Buffer& Sending(size_t index) const { return m_sending[index]; }
+    size_t InFlight() const { return m_sending.size(); }
+
+    //一个 send CQE 返回：按提交顺序确认队首；res 为 CQE 结果
+    //0 成功；<0 失败或短写（链已断开，连接应关闭）
+    int Complete(int res) {
+        if (m_sending.empty()) return -1;
+        size_t size = m_sending.front().size();
+        m_inflight -= size;
+        m_sending.pop_front();
+        if (res < 0 || (size_t)res != size) return -2;
+        return 0;
+    }
+
+    virtual int Close() {
+        m_queue.clear();
+        m_queued = 0;
+        return CSocket::Close();
+    }
+
+private:
+    std::deque<Buffer> m_queue;   //等待提交
+    std::deque<Buffer> m_sending; //已提交、未完成
+    size_t m_queued;
+    size_t m_inflight;
+};
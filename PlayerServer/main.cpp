@@ -1,10 +1,20 @@
 ﻿#include "CPlayerServer.h"
+#include <sys/wait.h>
+
+#define SYSTEM_CPUS 1 //留给接收线程和日志线程的 CPU 数，可用 CPU 不足 4 个时不做隔离
+
+static unsigned SystemCpus()
+{
+	return (CThread::AvailableCpus().size() >= 4) ? SYSTEM_CPUS : 0;
+}
 
 int CreateLogServer(CProcess* proc)
 {
 	//printf("%s(%d):<%s> pid=%d\n", __FILE__, __LINE__, __FUNCTION__, getpid());
 	CLoggerServer server;
-	int ret = server.Start();
+	CThreadParam param;
+	param.cpus = CCpuPolicy(SystemCpus()).SystemCpus();//日志线程不占业务核
+	int ret = server.Start(param);
 	if (ret != 0) {
 		printf("%s(%d):<%s> pid=%d errno:%d msg:%s ret:%d\n",
 			__FILE__, __LINE__, __FUNCTION__, getpid(), errno, strerror(errno), ret);
@@ -300,30 +310,237 @@ int crypto_test()
 	return 0;
 }
 
+//线程池自检：外部线程和池内线程各做一次扇出 + 汇合
+static std::atomic<int> s_poolSum(0);
+static int PoolLeaf(int value)
+{
+	s_poolSum += value;
+	return (value == 7) ? 7 : 0;//组内第一个非 0 的返回值应当被 Wait 带回
+}
+static int PoolRequest(CThreadPool* pool, int base)
+{
+	int items[16];
+	for (int i = 0; i < 16; i++)items[i] = base + i;
+	CTaskGroup group;
+	int count = pool->AddTasks(group, items, items + 16, PoolLeaf);
+	int ret = pool->Wait(group);//在池内线程上汇合：边等边执行，所有线程都在等也不会死锁
+	return (count == 16) ? ret : -1;
+}
+int pool_test()
+{
+	CThreadPool pool;
+	int ret = pool.Start(2);
+	printf("%s(%d):<%s> ret=%d\n", __FILE__, __LINE__, __FUNCTION__, ret);
+	if (ret != 0)return -1;
+	CTaskFuture future;
+	ret = pool.AddTask(future, PoolLeaf, 7);
+	printf("%s(%d):<%s> ret=%d except 7 get=%d\n", __FILE__, __LINE__, __FUNCTION__, ret, future.Get());
+	s_poolSum = 0;
+	CTaskGroup group;
+	for (int i = 0; i < 4; i++)pool.AddTask(group, PoolRequest, &pool, i * 16);//请求数多于线程数
+	ret = pool.Wait(group);
+	printf("%s(%d):<%s> except 7 ret=%d, except 2016 sum=%d\n", __FILE__, __LINE__, __FUNCTION__, ret, s_poolSum.load());
+	pool.Close();
+	return (ret == 7 && s_poolSum == 2016) ? 0 : -2;
+}
+
+//io_uring 自检：本地回环上 accept + 多发 recv 收请求、链接 send 回响应；再让一条链在第一个 send 处失败
+#define URING_TAG_ACCEPT 1
+#define URING_TAG_RECV 2
+#define URING_TAG_SEND 3
+struct UringTestState {
+	int server = -1;     //accept 得到的连接
+	Buffer received;     //recv 收到的数据
+	std::vector<int> sends; //send CQE 的结果，按返回顺序
+};
+static void UringTestReap(CUring& ring, UringTestState& state)
+{
+	ring.Submit(1);
+	ring.Reap([&ring, &state](io_uring_cqe* cqe) {
+		if (cqe->user_data == URING_TAG_ACCEPT) state.server = cqe->res;
+		else if (cqe->user_data == URING_TAG_SEND) state.sends.push_back(cqe->res);
+		else if ((cqe->user_data == URING_TAG_RECV) && (cqe->flags & IORING_CQE_F_BUFFER)) {
+			uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+			if (cqe->res > 0) state.received.append(ring.BufferAddr(bid), cqe->res);
+			ring.RecycleBuffer(bid);
+		}
+	});
+}
+static void UringTestChain(CUring& ring, CUringSocket& sock, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		const Buffer& data = sock.Sending(i);
+		CUring::PrepSend(ring.GetSqe(), sock, data.data(), data.size(), URING_TAG_SEND, i + 1 < count);
+	}
+}
+int uring_test()
+{
+	CUring ring;
+	if ((ring.Init() != 0) || (ring.SetupBuffers() != 0)) {
+		printf("%s(%d):<%s> io_uring unavailable, skipped\n", __FILE__, __LINE__, __FUNCTION__);
+		return 0;
+	}
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	CSocket listener(socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+	if ((bind(listener, (sockaddr*)&addr, len) != 0) || (listen(listener, 4) != 0)) return -1;
+	getsockname(listener, (sockaddr*)&addr, &len);
+	CSocket client(socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+	if (connect(client, (sockaddr*)&addr, len) != 0) return -2;
+
+	UringTestState state;
+	CUring::PrepAccept(ring.GetSqe(), listener, URING_TAG_ACCEPT);
+	while (state.server < 0) UringTestReap(ring, state);
+	CUringSocket sock(state.server);
+	sock.Init(CSockParam());
+	CUring::PrepRecv(ring.GetSqe(), sock, URING_TAG_RECV);
+	send(client, "ping", 4, 0);
+	while (state.received.size() < 4) UringTestReap(ring, state);
+	printf("%s(%d):<%s> except ping request=%s\n", __FILE__, __LINE__, __FUNCTION__, (char*)state.received);
+	if (memcmp(state.received.data(), "ping", 4) != 0) return -3;
+
+	//响应分两个 Buffer，作为一条链提交
+	sock.Send("po");
+	sock.Send("ng");
+	size_t count = sock.Prepare();
+	UringTestChain(ring, sock, count);
+	while (state.sends.size() < count) UringTestReap(ring, state);
+	for (int res : state.sends) if (sock.Complete(res) != 0) return -4;
+	char reply[8] = "";
+	ssize_t size = recv(client, reply, sizeof(reply), MSG_WAITALL | MSG_DONTWAIT);
+	printf("%s(%d):<%s> except pong response=%.*s inflight=%d\n", __FILE__, __LINE__, __FUNCTION__, (int)size, reply, (int)sock.InFlight());
+	if ((size != 4) || (memcmp(reply, "pong", 4) != 0) || (sock.InFlight() != 0)) return -5;
+
+	//SQ 放不下时退回排队：顺序不变
+	sock.Send("a");
+	sock.Send("bc");
+	count = sock.Prepare();
+	sock.Requeue();
+	if ((count != 2) || (sock.InFlight() != 0) || (sock.Pending() != 3)) return -6;
+	count = sock.Prepare();
+	if ((count != 2) || (sock.Sending(0).size() != 1) || (sock.Sending(1).size() != 2)) return -7;
+
+	//写方向关闭后提交：第一个 send 失败，链上其余的以 -ECANCELED 返回，在途数必须归零
+	shutdown(sock, SHUT_WR);
+	state.sends.clear();
+	UringTestChain(ring, sock, count);
+	while (state.sends.size() < count) UringTestReap(ring, state);
+	int failed = 0;
+	for (int res : state.sends) if (sock.Complete(res) < 0) failed++;
+	printf("%s(%d):<%s> except -32 -125 sends=%d %d inflight=%d\n", __FILE__, __LINE__, __FUNCTION__,
+		state.sends[0], state.sends[1], (int)sock.InFlight());
+	if ((failed != 2) || (state.sends[1] != -ECANCELED) || (sock.InFlight() != 0)) return -8;
+	return 0;
+}
+
+//连接槽自检：fd 被复用后，旧连接的键因代数不同而查不到
+int slab_test()
+{
+	CConnectionSlab slab;
+	int ret = slab.Init(1024);
+	if (ret != 0) return -1;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	CConnection* first = slab.Acquire(new CSocket(fd));
+	if (first == nullptr) return -2;
+	uint64_t stale = first->Key();
+	slab.Release(first);//关闭 fd：单线程下新套接字一定拿到同一个 fd
+	CConnection* second = slab.Acquire(new CSocket(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)));
+	if (second == nullptr) return -3;
+	printf("%s(%d):<%s> except same fd old=%d new=%d, except null stale=%p\n", __FILE__, __LINE__, __FUNCTION__,
+		(int)(uint32_t)stale, second->Fd(), (void*)slab.Find(stale));
+	ret = 0;
+	if (second->Fd() != fd) ret = -4;
+	else if (slab.Find(stale) != nullptr) ret = -5;
+	else if (slab.Find(second->Key()) != second) ret = -6;
+	slab.Release(second);
+	return ret;
+}
+
+//时间轮自检：到期的节点回调一次，取消的和未到期的不回调
+int wheel_test()
+{
+	CTimingWheel wheel;
+	int ret = wheel.Init();
+	if (ret != 0) return -1;
+	CTimerNode early, late, cancelled;
+	wheel.Schedule(&early, 2 * TIMER_TICK_MS, 1);
+	wheel.Schedule(&late, 50 * TIMER_TICK_MS, 2);
+	wheel.Schedule(&cancelled, 2 * TIMER_TICK_MS, 3);
+	wheel.Cancel(&cancelled);
+	unsigned fired = 0, kinds = 0;
+	for (int i = 0; i < 10; i++) {//最多等 10 个刻度
+		pollfd pfd = { (int)wheel, POLLIN, 0 };
+		poll(&pfd, 1, 2 * TIMER_TICK_MS);
+		wheel.Expire([&](CTimerNode* node) {
+			fired++;
+			kinds |= 1u << node->Kind();
+		});
+		if (fired > 0) break;
+	}
+	printf("%s(%d):<%s> except 1 fired=%u, except 2 kinds=%u\n", __FILE__, __LINE__, __FUNCTION__, fired, kinds);
+	ret = ((fired == 1) && (kinds == 2) && !early.Active() && late.Active() && !cancelled.Active()) ? 0 : -2;
+	wheel.Cancel(&late);
+	return ret;
+}
+
+//不依赖数据库的自检，"--selftest" 时运行
+int self_test()
+{
+	int ret = pool_test();
+	if (ret != 0) return ret;
+	ret = uring_test();
+	if (ret != 0) return ret - 100;
+	ret = slab_test();
+	if (ret != 0) return ret - 200;
+	ret = wheel_test();
+	if (ret != 0) return ret - 300;
+	return 0;
+}
+
 int Main()
 {
 	int ret = 0;
+	ret = CServer::BlockSignals();//退出信号由 CServer::Run 统一处理，Ctrl-C 不会直接杀掉日志进程和业务进程
+	ERR_RETURN(ret, -5);
 	CProcess proclog;//启动日志子进程
 	ret = proclog.SetEntryFunction(CreateLogServer, &proclog);
 	ERR_RETURN(ret, -1);
 	ret = proclog.CreateSubProcess();
 	ERR_RETURN(ret, -2);
-	CPlayerServer business(2);//创建业务对象
-	CServer server;//启动服务器
-	ret = server.Init(&business, "0.0.0.0", 19527);
+	CPlayerServer business(2, REACTOR_LEASTLOAD);//创建业务对象，每个工作线程一个事件循环
+	CServer server;//启动服务器，每个核一个业务子进程
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	CServerParam param("0.0.0.0", 19527, SERVER_HANDOFF, cores > 0 ? (unsigned)cores : 1);
+	param.option.nodelay = true;     //小 JSON 响应不等 Nagle/延迟 ACK
+	param.option.defer_accept = 5;   //连上后不发数据的连接不唤醒 accept
+	param.hang = 30000;              //事件循环全部卡住 30 秒的子进程强制重启
+	param.reservecpus = SystemCpus(); //接收线程独占系统核，业务线程每核一个
+	ret = server.Init(&business, param);
 	ERR_RETURN(ret, -3);
-	ret = server.Run();
+	ret = server.Supervise(&proclog);//日志进程意外退出后由 Run 重新拉起
+	ERR_RETURN(ret, -6);
+	ret = server.Run();//收到 SIGTERM/SIGINT/SIGHUP 后返回，此时业务子进程已排空并回收
 	ERR_RETURN(ret, -4);
+	proclog.ClosePipe();//日志进程收到 EOF 后退出
+	waitpid(proclog.Pid(), NULL, 0);
 	return 0;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
 	int ret = 0;
 	//int ret = http_test();
 	//ret = sql_test();
 	//ret = mysql_test();
 	//ret = crypto_test();
+	if ((argc > 1) && (strcmp(argv[1], "--selftest") == 0)) {
+		ret = self_test();
+		printf("self_test:ret = %d\n", ret);
+		return ret;
+	}
 	ret = Main();
 	printf("main:ret = %d\n", ret);
 	return ret;